@@ -0,0 +1,84 @@
+// Checks the default temperature calibration against the step tables it
+// replaced in TemperatureTask, on every float reading from 25 to 40°C. Steps
+// must match exactly, ranges mapped with an offset up to float rounding.
+// Exits with 1 if a check fails:
+//
+//   ./calibration-test
+
+#include <cmath>
+#include <cstdio>
+
+#include "calibration_curve.hpp"
+#include "test_check.hpp"
+
+using namespace suanzi;
+
+static float legacy_surface_to_inner(float temperature, bool &shifted) {
+  shifted = true;
+  if (temperature < 33) return temperature + 2.8;
+  shifted = false;
+  if (temperature <= 33.1) return 35.8;
+  if (temperature <= 33.2) return 35.9;
+  if (temperature <= 33.5) return 36;
+  if (temperature <= 33.7) return 36.1;
+  if (temperature <= 34.1) return 36.2;
+  if (temperature <= 34.3) return 36.3;
+  if (temperature <= 34.4) return 36.4;
+  if (temperature <= 34.7) return 36.5;
+  if (temperature <= 34.8) return 36.6;
+  if (temperature <= 35.1) return 36.7;
+  if (temperature <= 35.5) return 36.8;
+  if (temperature <= 35.7) return 36.9;
+  if (temperature <= 36.1) return 37;
+  if (temperature <= 36.3) return 37.1;
+  if (temperature <= 36.4) return 37.2;
+  if (temperature <= 36.5) return 37.3;
+  if (temperature <= 36.6) return 37.5;
+  if (temperature <= 36.8) return 37.6;
+  shifted = true;
+  return temperature + 0.8;
+}
+
+static float legacy_measure_to_surface(float temperature, bool &shifted) {
+  shifted = true;
+  if (temperature <= 29.6) return temperature + 5.3;
+  shifted = false;
+  if (temperature <= 29.7) return 35.1;
+  if (temperature <= 29.8) return 35.2;
+  if (temperature <= 30.3) return 35.5;
+  if (temperature <= 30.4) return 35.6;
+  if (temperature <= 30.9) return 35.7;
+  if (temperature <= 31.2) return 35.8;
+  if (temperature <= 31.3) return 36.1;
+  shifted = true;
+  if (temperature <= 31.8) return temperature + 4.8;
+  shifted = false;
+  if (temperature <= 31.9) return 36.7;
+  if (temperature <= 32) return 36.9;
+  shifted = true;
+  return temperature + 4.9;
+}
+
+static void check(float expected, float actual, bool shifted) {
+  if (shifted)
+    CHECK(std::fabs(expected - actual) <= 1e-5);
+  else
+    CHECK(expected == actual);
+}
+
+int main() {
+  auto c = default_temperature_calibration();
+
+  int readings = 0;
+  for (float t = 25; t <= 40; t = std::nextafter(t, 41.f), readings++) {
+    bool shifted;
+    float expected = legacy_measure_to_surface(t, shifted);
+    check(expected, c.measure_to_surface.map(t), shifted);
+    expected = legacy_surface_to_inner(t, shifted);
+    check(expected, c.surface_to_inner.map(t), shifted);
+    if (failures > 10) break;
+  }
+
+  printf("%d readings\n", readings);
+  return check_result();
+}
@@ -0,0 +1,216 @@
+// Checks the geometry module against the overlap formula it replaced in
+// DetectionRatio::is_overlap and DetectTask::is_stable, and measures the
+// scalar and batch overlap scores. Exits with 1 if a check fails:
+//
+//   ./geometry-test --boxes 64 --iterations 10000
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "geometry.hpp"
+#include "test_check.hpp"
+
+using namespace suanzi::geometry;
+
+static bool near(float a, float b) { return std::fabs(a - b) < 1e-5f; }
+
+static bool near(const Box &a, const Box &b) {
+  return near(a.x, b.x) && near(a.y, b.y) && near(a.width, b.width) &&
+         near(a.height, b.height);
+}
+
+// The formula of the previous code, -1 when the boxes are disjoint
+static float legacy_overlap(const Box &a, const Box &b) {
+  float x1 = a.x, x2 = b.x, y1 = a.y, y2 = b.y;
+  float w1 = a.width, w2 = b.width, h1 = a.height, h2 = b.height;
+  if (x1 > x2 + w2 || y1 > y2 + h2 || x1 + w1 < x2 || y1 + h1 < y2) return -1;
+
+  float overlay_w = std::min(x1 + w1, x2 + w2) - std::max(x1, x2);
+  float overlay_h = std::min(y1 + h1, y2 + h2) - std::max(y1, y2);
+  return overlay_w * overlay_h / (w1 * h1 + w2 * h2) * 2;
+}
+
+static std::mt19937 rng(42);
+
+static Box random_box() {
+  std::uniform_real_distribution<float> pos(0, 0.8), size(0.01, 0.4);
+  return {pos(rng), pos(rng), size(rng), size(rng)};
+}
+
+static void test_scores() {
+  Box a = {0.1, 0.1, 0.4, 0.4};
+  CHECK(near(iou(a, a), 1));
+  CHECK(near(dice(a, a), 1));
+  CHECK(near(intersection_over_hull(a, a), 1));
+
+  // Half of a overlaps b, which has the same size
+  Box b = {0.3, 0.1, 0.4, 0.4};
+  CHECK(near(intersection(a, b), 0.08));
+  CHECK(near(iou(a, b), 0.08f / 0.24f));
+  CHECK(near(dice(a, b), 0.5));
+  CHECK(near(intersection_over_hull(a, b), 0.08f / 0.24f));
+
+  Box far = {0.6, 0.6, 0.1, 0.1};
+  CHECK(is_disjoint(a, far));
+  CHECK(intersection(a, far) == 0);
+  CHECK(iou(a, far) == 0);
+  CHECK(dice(a, far) == 0);
+
+  Box empty = {0, 0, 0, 0};
+  CHECK(iou(empty, empty) == 0);
+  CHECK(dice(empty, empty) == 0);
+
+  CHECK(near(scale(a, 1920, 1080), Box{192, 108, 768, 432}));
+}
+
+static void test_legacy_overlap() {
+  for (int i = 0; i < 100000; i++) {
+    Box a = random_box(), b = random_box();
+    float legacy = legacy_overlap(a, b);
+    if (legacy < 0)
+      CHECK(is_disjoint(a, b));
+    else
+      CHECK(near(dice(a, b), legacy));
+  }
+}
+
+static void test_rotation() {
+  Box b = {0.1, 0.2, 0.3, 0.4};
+  for (int k = 0; k < 4; k++) {
+    // Four quarter turns are the identity
+    Box r = b;
+    for (int i = 0; i < 4; i++) r = rotate(r, k == 0 ? 1 : k);
+    CHECK(near(r, b));
+  }
+
+  CHECK(near(rotate(b, 0), Rotation<0>::apply(b)));
+  CHECK(near(rotate(b, 1), Rotation<1>::apply(b)));
+  CHECK(near(rotate(b, 2), Rotation<2>::apply(b)));
+  CHECK(near(rotate(b, 3), Rotation<3>::apply(b)));
+  CHECK(near(rotate(b, 5), Rotation<1>::apply(b)));
+
+  // A box rotates like its corners
+  for (int k = 0; k < 4; k++) {
+    Point p1 = rotate(Point{b.x, b.y}, k);
+    Point p2 = rotate(Point{right(b), bottom(b)}, k);
+    Box r = rotate(b, k);
+    CHECK(near(r.x, std::min(p1.x, p2.x)));
+    CHECK(near(r.y, std::min(p1.y, p2.y)));
+    CHECK(near(right(r), std::max(p1.x, p2.x)));
+    CHECK(near(bottom(r), std::max(p1.y, p2.y)));
+  }
+
+  // Overlap scores do not depend on the rotation
+  Box a = {0.3, 0.1, 0.4, 0.4};
+  for (int k = 0; k < 4; k++)
+    CHECK(near(dice(rotate(a, k), rotate(b, k)), dice(a, b)));
+}
+
+static void test_batch() {
+  BoxArray boxes;
+  CHECK(select_largest(boxes) == -1);
+
+  Box a = random_box();
+  for (int i = 0; i < 1000; i++) boxes.push_back(random_box());
+  CHECK(boxes.size() == 1000);
+
+  std::vector<float> inter(boxes.size()), ious(boxes.size()),
+      dices(boxes.size());
+  intersection(a, boxes, inter.data());
+  iou(a, boxes, ious.data());
+  dice(a, boxes, dices.data());
+
+  int largest = 0;
+  for (size_t i = 0; i < boxes.size(); i++) {
+    Box b = boxes.at(i);
+    CHECK(near(inter[i], intersection(a, b)));
+    CHECK(near(ious[i], iou(a, b)));
+    CHECK(near(dices[i], dice(a, b)));
+    if (area(b) > area(boxes.at(largest))) largest = i;
+  }
+  CHECK(select_largest(boxes) == largest);
+
+  boxes.clear();
+  CHECK(boxes.size() == 0);
+}
+
+template <class F>
+static void report(const char *name, F f, int boxes, int iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  printf("%-16s %10.2f\n", name, ns / iterations / boxes);
+}
+
+static void benchmark(int count, int iterations) {
+  Box a = random_box();
+  BoxArray boxes;
+  std::vector<Box> list;
+  for (int i = 0; i < count; i++) {
+    Box b = random_box();
+    boxes.push_back(b);
+    list.push_back(b);
+  }
+  std::vector<float> out(count);
+
+  // Read back, so the loops are not optimized away
+  volatile float sink = 0;
+  auto legacy_loop = [&]() {
+    for (int i = 0; i < count; i++) out[i] = legacy_overlap(list[i], a);
+    sink = sink + out[0];
+  };
+  auto dice_loop = [&]() {
+    for (int i = 0; i < count; i++) out[i] = dice(a, list[i]);
+    sink = sink + out[0];
+  };
+  auto dice_batch = [&]() {
+    dice(a, boxes, out.data());
+    sink = sink + out[0];
+  };
+  auto iou_loop = [&]() {
+    for (int i = 0; i < count; i++) out[i] = iou(a, list[i]);
+    sink = sink + out[0];
+  };
+  auto iou_batch = [&]() {
+    iou(a, boxes, out.data());
+    sink = sink + out[0];
+  };
+  auto largest = [&]() { sink = sink + select_largest(boxes); };
+
+  printf("%-16s %10s\n", "score", "ns/box");
+  report("legacy overlap", legacy_loop, count, iterations);
+  report("dice", dice_loop, count, iterations);
+  report("dice batch", dice_batch, count, iterations);
+  report("iou", iou_loop, count, iterations);
+  report("iou batch", iou_batch, count, iterations);
+  report("select_largest", largest, count, iterations);
+}
+
+int main(int argc, char *argv[]) {
+  int boxes = 64;
+  int iterations = 10000;
+
+  for (int i = 1; i < argc - 1; i++) {
+    auto arg = std::string(argv[i]);
+    if (arg == "--boxes")
+      boxes = atoi(argv[++i]);
+    else if (arg == "--iterations")
+      iterations = atoi(argv[++i]);
+  }
+
+  test_scores();
+  test_legacy_overlap();
+  test_rotation();
+  test_batch();
+  if (check_result() != 0) return 1;
+  printf("\n");
+
+  benchmark(boxes, iterations);
+  return 0;
+}
@@ -0,0 +1,66 @@
+// Measures the cost of a heatmap update for the thermal sensor resolutions
+// we deploy, rendered at the size of the heatmap widget on the screen:
+//
+//   ./heatmap-benchmark --width 150 --height 150 --iterations 1000
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <QImage>
+
+#include "heatmap_widget.hpp"
+#include "thermal_frame.hpp"
+
+using namespace suanzi;
+
+int main(int argc, char *argv[]) {
+  int width = 150, height = 150;
+  int iterations = 1000;
+
+  for (int i = 1; i < argc - 1; i++) {
+    auto arg = std::string(argv[i]);
+    if (arg == "--width")
+      width = atoi(argv[++i]);
+    else if (arg == "--height")
+      height = atoi(argv[++i]);
+    else if (arg == "--iterations")
+      iterations = atoi(argv[++i]);
+  }
+
+  const int sizes[][2] = {{16, 16}, {32, 32}, {80, 62}};
+
+  printf("%-10s %12s %12s\n", "sensor", "update", "per pixel");
+  for (auto &size : sizes) {
+    // A warm blob moving over the ambient temperature
+    ThermalFrame frame(size[0], size[1]);
+    QImage image(width, height, QImage::Format_RGB32);
+    HeatmapRenderer renderer;
+
+    double total_us = 0;
+    for (int n = 0; n < iterations; n++) {
+      float cx = frame.width * (0.5f + 0.2f * std::sin(n * 0.1f));
+      float cy = frame.height * 0.5f;
+      for (int y = 0; y < frame.height; y++) {
+        for (int x = 0; x < frame.width; x++) {
+          float d = std::hypot(x - cx, y - cy) / frame.width;
+          frame.values[y * frame.width + x] = 26 + 10 * std::exp(-8 * d * d);
+        }
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      renderer.render(frame, image);
+      total_us += std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    }
+
+    double avg_us = total_us / iterations;
+    printf("%4dx%-5d %10.1fus %10.2fns\n", size[0], size[1], avg_us,
+           avg_us * 1000 / (width * height));
+  }
+
+  return 0;
+}
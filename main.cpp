@@ -2,9 +2,13 @@
 #include <QTranslator>
 #include <QtWidgets/QApplication>
 
+#include "face_journal.hpp"
 #include "face_server.hpp"
 #include "http_server.hpp"
 #include "led_task.hpp"
+#include "model_registry.hpp"
+#include "startup_graph.hpp"
+#include "task_executor.hpp"
 #include "video_player.hpp"
 
 using namespace suanzi;
@@ -190,31 +194,57 @@ Engine* create_engine() {
 }
 
 VideoPlayer* create_gui() {
-  // 预加载 Quface 算法模块
-  auto quface = Config::get_quface();
-  std::make_shared<FaceDetector>(quface.model_file_path);
-  std::make_shared<FaceExtractor>(quface.model_file_path);
-  std::make_shared<FacePoseEstimator>(quface.model_file_path);
-  std::make_shared<FaceAntiSpoofing>(quface.model_file_path);
-  std::make_shared<MaskDetector>(quface.model_file_path);
-  std::make_shared<FaceDatabase>(quface.db_name);
-
-  // 加载 Web 服务模块
   static auto person_service = PersonService::get_instance();
-  static auto face_service = std::make_shared<FaceService>(person_service);
-  static auto face_server = std::make_shared<FaceServer>(face_service);
-  static auto http_server = std::make_shared<HTTPServer>();
-  face_server->add_event_source(http_server);
+  static std::shared_ptr<FaceService> face_service;
+  static std::shared_ptr<FaceServer> face_server;
+  static std::shared_ptr<HTTPServer> http_server;
+  VideoPlayer* gui = nullptr;
 
-  auto app_cfg = Config::get_app();
-  std::thread t(
-      [&]() { http_server->run(app_cfg.server_port, app_cfg.server_host); });
-  t.detach();
+  // 启动步骤按依赖关系并行执行，Qt 控件只能在主线程中创建
+  StartupGraph graph;
+
+  // 预加载 Quface 算法模块，识别线程复用同一组模型实例
+  graph.add("models", {}, []() { ModelRegistry::get_instance()->preload(); });
+  graph.add("service_models", {}, []() {
+    auto models = ModelRegistry::get_instance();
+    models->detector(MODEL_CONTEXT_SERVICE);
+    models->extractor(MODEL_CONTEXT_SERVICE);
+    models->pose_estimator(MODEL_CONTEXT_SERVICE);
+  });
+
+  // 加载人脸底库，并重放未合并的底库修改日志
+  graph.add("database", {}, []() { FaceJournal::get_instance(); });
+
+  // 加载语音文件
+  graph.add("audio", {}, []() { AudioTask::get_instance(); });
+
+  // 加载 Web 服务模块
+  graph.add("http_server", {"service_models", "database"}, []() {
+    face_service = std::make_shared<FaceService>(person_service);
+    face_server = std::make_shared<FaceServer>(face_service);
+    http_server = std::make_shared<HTTPServer>();
+    face_server->add_event_source(http_server);
+
+    auto app_cfg = Config::get_app();
+    std::thread t([app_cfg]() {
+      TaskExecutor::pin_current_thread(LANE_BACKGROUND);
+      http_server->run(app_cfg.server_port, app_cfg.server_host);
+    });
+    t.detach();
+  });
+
+  // 创建识别流程和界面
+  graph.add("gui", {"models", "database", "audio"},
+            [&gui]() { gui = new VideoPlayer(); }, true);
+
+  bool ok = graph.run();
+  graph.report(APP_DIR_PREFIX "/var/startup_report.txt");
+  ModelRegistry::get_instance()->report();
 
   auto engine = Engine::instance();
   engine->stop_boot_ui();
 
-  return new VideoPlayer();
+  return ok ? gui : nullptr;
 }
 
 int main(int argc, char* argv[]) {
@@ -232,14 +262,21 @@ int main(int argc, char* argv[]) {
   QApplication::setOverrideCursor(Qt::BlankCursor);
   // Step 4: 多语言支持
   load_translator(app);
-  config->appendListener("reload", [&app]() { load_translator(app); });
+  config->appendListener(
+      "user", [&app](const ConfigChange&) { load_translator(app); });
 
   // Step 4.1: LED配置修改触发反馈
   Engine::instance()->gpio_set(GpioPinLightBox, false);
   trigger_gpio();
-  config->appendListener("reload", trigger_led);
-  config->appendListener("reload", trigger_gpio);
-  config->appendListener("reload", reset_temperature);
+  config->appendListener("user", [](const ConfigChange& change) {
+    auto& prev = change.prev->data.user;
+    auto& cur = change.cur->data.user;
+    if (prev.enable_led != cur.enable_led) trigger_led();
+    if (prev.relay_default_state != cur.relay_default_state) trigger_gpio();
+    if (prev.temperature_bias != cur.temperature_bias ||
+        prev.temperature_finetune != cur.temperature_finetune)
+      reset_temperature();
+  });
 
   // Step 5: 播放自定义开机画面
   std::vector<SZ_BYTE> img;
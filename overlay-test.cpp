@@ -0,0 +1,340 @@
+// Measures the paint cost of the overlay widgets of VideoPlayer without the
+// cameras. The widgets are created on a root widget of the screen size and
+// fed with a fake stream of detections, recognitions and thermal frames.
+//
+// The stream is first played through the event loop, so the widgets repaint
+// as on the device: changes are batched by OverlayCompositor, flushed once per
+// refresh, and only the dirty regions are painted while the window handles
+// UpdateRequest. The compositor times each of these frames. Then every frame
+// each widget and the whole overlay are rendered to an image, which times the
+// full repaint of each widget alone.
+//
+// Runs on the offscreen platform unless QT_QPA_PLATFORM is set, so neither a
+// display nor the cameras are needed. Exits with 1 if the 95th percentile of
+// the compositor frame time is over the budget:
+//
+//   ./overlay-test --config config.json --frames 300 --budget-ms 8
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QThread>
+#include <QWidget>
+
+#include <quface/logger.hpp>
+
+#include "config.hpp"
+#include "detect_tip_widget.hpp"
+#include "heatmap_widget.hpp"
+#include "outline_widget.hpp"
+#include "overlay_compositor.hpp"
+#include "recognize_tip_widget.hpp"
+#include "status_banner.hpp"
+#include "temperature_tip_widget.hpp"
+#include "thermal_frame.hpp"
+
+using namespace suanzi;
+
+// Emits the signals of DetectTask, RecordTask and TemperatureTask consumed by
+// the widgets
+class FakeStream : public QObject {
+  Q_OBJECT
+
+ public:
+  // A 24x32 module at about 8 frames per second
+  static constexpr int THERMAL_WIDTH = 24;
+  static constexpr int THERMAL_HEIGHT = 32;
+  static constexpr int THERMAL_INTERVAL = 4;
+
+  FakeStream() : frame_(0) {}
+
+  void start() { emit tx_heatmap_init(10); }
+
+  void next() {
+    frame_++;
+
+    // A face drifting around the center, lost for a while every 4 seconds
+    bool lost = frame_ % 120 > 100;
+    DetectionRatio detection = {};
+    detection.x = 0.35 + 0.05 * std::sin(frame_ * 0.1);
+    detection.y = 0.3 + 0.05 * std::cos(frame_ * 0.07);
+    detection.width = 0.3;
+    detection.height = 0.25;
+    emit tx_bgr_display(detection, lost, frame_ % 30 > 10, true);
+    emit tx_nir_display(detection, lost, true, false);
+
+    if (frame_ % THERMAL_INTERVAL == 0) {
+      float x = detection.x + detection.width / 2;
+      float y = detection.y + detection.height / 2;
+      emit tx_heatmap(thermal_frame(lost ? -1 : x, y), detection, x, y);
+    }
+
+    // A recognition every second
+    if (frame_ % 30 == 0) {
+      PersonData person = {};
+      person.id = frame_ / 30;
+      person.score = 0.9;
+      person.name = "Test " + std::to_string(person.id);
+      person.status = PersonService::get_status(PersonStatus::Normal);
+      person.face_path = ":asserts/avatar_unknown.jpg";
+      person.face_snapshot =
+          cv::Mat(200, 160, CV_8UC3, cv::Scalar(64, 128, 192));
+      emit tx_display(person, false, false);
+    }
+  }
+
+ signals:
+  void tx_bgr_display(DetectionRatio detection, bool to_clear, bool valid,
+                      bool show_pose);
+  void tx_nir_display(DetectionRatio detection, bool to_clear, bool valid,
+                      bool show_pose);
+  void tx_display(PersonData person, bool audio_duplicated,
+                  bool record_duplicated);
+  void tx_heatmap_init(int success);
+  void tx_heatmap(ThermalFrame frame, DetectionRatio detection, float x,
+                  float y);
+
+ private:
+  // The ambient temperature with a warm face around (x, y), none if x < 0
+  ThermalFrame thermal_frame(float x, float y) {
+    ThermalFrame frame(THERMAL_WIDTH, THERMAL_HEIGHT);
+    for (int j = 0; j < THERMAL_HEIGHT; j++) {
+      for (int i = 0; i < THERMAL_WIDTH; i++) {
+        float dx = (float)i / THERMAL_WIDTH - x;
+        float dy = (float)j / THERMAL_HEIGHT - y;
+        float face = x < 0 ? 0 : 11 * std::exp(-(dx * dx + dy * dy) * 40);
+        float noise = 0.2f * std::sin(frame_ * 0.3f + i * 1.7f + j * 2.9f);
+        frame.values[j * THERMAL_WIDTH + i] = 25 + face + noise;
+      }
+    }
+    return frame;
+  }
+
+  int frame_;
+};
+
+constexpr int FakeStream::THERMAL_WIDTH;
+constexpr int FakeStream::THERMAL_HEIGHT;
+constexpr int FakeStream::THERMAL_INTERVAL;
+
+struct Timing {
+  std::vector<double> ms;
+
+  double percentile(double p) {
+    if (ms.empty()) return 0;
+    std::vector<double> sorted = ms;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+  }
+
+  double average() {
+    double sum = 0;
+    for (double v : ms) sum += v;
+    return ms.empty() ? 0 : sum / ms.size();
+  }
+};
+
+// Runs the event loop until the compositor has painted a frame, and returns
+// its paint time, or -1 if nothing was painted within timeout_ms
+static double compositor_frame_ms(int timeout_ms) {
+  auto compositor = OverlayCompositor::get_instance();
+  auto frame_stats = [compositor]() {
+    auto stats = compositor->stats();
+    auto it = stats.find("frame");
+    return it == stats.end() ? OverlayCompositor::PaintStats{0, 0, 0}
+                             : it->second;
+  };
+
+  auto before = frame_stats();
+  QElapsedTimer timer;
+  timer.start();
+  while (timer.elapsed() < timeout_ms) {
+    QCoreApplication::processEvents();
+    auto after = frame_stats();
+    // The stats are cleared by the periodic report
+    if (after.count < before.count) before = {0, 0, 0};
+    if (after.count > before.count)
+      return (after.total_us - before.total_us) / 1000.;
+    QThread::msleep(1);
+  }
+  return -1;
+}
+
+static void print_timing(const std::string &name, Timing &t) {
+  printf("%-16s %8zu %7.2fms %7.2fms %7.2fms\n", name.c_str(), t.ms.size(),
+         t.average(), t.percentile(0.95), t.percentile(1));
+}
+
+static double render_ms(QWidget *widget, QImage &image) {
+  auto start = std::chrono::steady_clock::now();
+  {
+    QPainter painter(&image);
+    widget->render(&painter, QPoint(), QRegion(),
+                   QWidget::DrawChildren | QWidget::DrawWindowBackground);
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  std::string cfg_file = "config.json";
+  std::string cfg_override_file = "config.override.json";
+  int frames = 300;
+  double budget_ms = 8;
+  int width = 800, height = 1280;
+
+  for (int i = 1; i < argc - 1; i++) {
+    auto arg = std::string(argv[i]);
+    if (arg == "-c" || arg == "--config")
+      cfg_file = argv[++i];
+    else if (arg == "-cc" || arg == "--override-config")
+      cfg_override_file = argv[++i];
+    else if (arg == "--frames")
+      frames = atoi(argv[++i]);
+    else if (arg == "--budget-ms")
+      budget_ms = atof(argv[++i]);
+    else if (arg == "--width")
+      width = atoi(argv[++i]);
+    else if (arg == "--height")
+      height = atoi(argv[++i]);
+  }
+
+  auto config = Config::get_instance();
+  if (SZ_RETCODE_OK != config->load_from_file(cfg_file, cfg_override_file)) {
+    SZ_LOG_ERROR("Load config {} failed", cfg_file);
+    return 1;
+  }
+
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QApplication app(argc, argv);
+  qRegisterMetaType<DetectionRatio>("DetectionRatio");
+  qRegisterMetaType<PersonData>("PersonData");
+  qRegisterMetaType<ThermalFrame>("ThermalFrame");
+
+  // The same widgets and layout as VideoPlayer::init_widgets
+  QWidget root;
+  root.setFixedSize(width, height);
+  QPalette pal = root.palette();
+  pal.setColor(QPalette::Background, Qt::transparent);
+  root.setPalette(pal);
+  OverlayCompositor::get_instance()->attach(&root);
+
+  int pip_percent = Config::get_app().infrared_window_percent;
+  std::map<std::string, QWidget *> widgets;
+  auto detect_bgr = new DetectTipWidget(0, 0, width, height, &root);
+  auto detect_nir = new DetectTipWidget(
+      width - width * pip_percent / 100, 0, width * pip_percent / 100,
+      height * pip_percent / 100, &root);
+  auto temperature_tip = new TemperatureTipWidget(width, height, &root);
+  auto recognize_tip = new RecognizeTipWidget(width, height, &root);
+  auto outline = new OutlineWidget(width, height, &root);
+  auto status_banner = new StatusBanner(width, height, &root);
+  auto heatmap = new HeatmapWidget(width, height, &root);
+  widgets["detect_bgr"] = detect_bgr;
+  widgets["detect_nir"] = detect_nir;
+  widgets["temperature_tip"] = temperature_tip;
+  widgets["recognize_tip"] = recognize_tip;
+  widgets["outline"] = outline;
+  widgets["status_banner"] = status_banner;
+  widgets["heatmap"] = heatmap;
+
+  FakeStream stream;
+  QObject::connect(
+      &stream, SIGNAL(tx_bgr_display(DetectionRatio, bool, bool, bool)),
+      detect_bgr, SLOT(rx_display(DetectionRatio, bool, bool, bool)));
+  QObject::connect(
+      &stream, SIGNAL(tx_nir_display(DetectionRatio, bool, bool, bool)),
+      detect_nir, SLOT(rx_display(DetectionRatio, bool, bool, bool)));
+  QObject::connect(&stream, SIGNAL(tx_display(PersonData, bool, bool)),
+                   recognize_tip, SLOT(rx_display(PersonData, bool, bool)));
+  QObject::connect(recognize_tip, SIGNAL(tx_temperature(bool, bool, float)),
+                   temperature_tip, SLOT(rx_temperature(bool, bool, float)));
+  QObject::connect(&stream, SIGNAL(tx_heatmap_init(int)), heatmap,
+                   SLOT(rx_init(int)));
+  QObject::connect(
+      &stream, SIGNAL(tx_heatmap(ThermalFrame, DetectionRatio, float, float)),
+      heatmap, SLOT(rx_update(ThermalFrame, DetectionRatio, float, float)));
+
+  root.show();
+  status_banner->show();
+  heatmap->show();
+  stream.start();
+
+  // The frames as painted on the device, through the compositor
+  const int FRAME_TIMEOUT_MS = 100;
+  Timing compositor;
+  compositor_frame_ms(FRAME_TIMEOUT_MS);
+  auto compositor_stats = OverlayCompositor::get_instance()->stats();
+  for (int i = 0; i < frames; i++) {
+    stream.next();
+    double ms = compositor_frame_ms(FRAME_TIMEOUT_MS);
+    if (ms >= 0) compositor.ms.push_back(ms);
+  }
+
+  // Paint times of the widgets which report them, during the frames above
+  printf("%-16s %8s %8s %8s\n", "compositor", "paints", "avg", "max");
+  for (auto &it : OverlayCompositor::get_instance()->stats()) {
+    auto s = it.second;
+    auto prev = compositor_stats.find(it.first);
+    if (prev != compositor_stats.end() && prev->second.count <= s.count) {
+      s.count -= prev->second.count;
+      s.total_us -= prev->second.total_us;
+    }
+    if (s.count == 0) continue;
+    printf("%-16s %8lld %7.2fms %7.2fms\n", it.first.c_str(),
+           (long long)s.count, s.total_us / 1000. / s.count, s.max_us / 1000.);
+  }
+  printf("\n");
+
+  // Every widget repainted in full, one by one
+  QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+  Timing overlay;
+  std::map<std::string, Timing> timings;
+  for (int i = 0; i < frames; i++) {
+    stream.next();
+    app.processEvents();
+
+    image.fill(Qt::transparent);
+    overlay.ms.push_back(render_ms(&root, image));
+    for (auto &it : widgets) {
+      if (it.second->isVisible())
+        timings[it.first].ms.push_back(render_ms(it.second, image));
+    }
+  }
+
+  printf("%-16s %8s %8s %8s %8s\n", "render", "frames", "avg", "p95", "max");
+  for (auto &it : timings) print_timing(it.first, it.second);
+  print_timing("overlay", overlay);
+  printf("\n");
+
+  printf("%-16s %8s %8s %8s %8s\n", "frame", "frames", "avg", "p95", "max");
+  print_timing("compositor", compositor);
+
+  if (compositor.ms.empty()) {
+    printf("FAILED: the compositor painted no frame\n");
+    return 1;
+  }
+  double p95 = compositor.percentile(0.95);
+  if (p95 > budget_ms) {
+    printf("FAILED: compositor p95 %.2fms is over the budget of %.2fms\n",
+           p95, budget_ms);
+    return 1;
+  }
+  printf("OK: compositor p95 %.2fms within the budget of %.2fms\n", p95,
+         budget_ms);
+  return 0;
+}
+
+#include "overlay-test.moc"
@@ -1,5 +1,8 @@
 #include "audio_task.hpp"
 
+#include <string>
+#include <utility>
+
 #include <QFile>
 #include <QThread>
 #include <QTimer>
@@ -8,6 +11,7 @@
 
 #include "config.hpp"
 #include "gpio_task.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 
@@ -19,35 +23,74 @@ AudioTask* AudioTask::get_instance() {
 bool AudioTask::idle() { return !get_instance()->is_running_; }
 
 SZ_UINT16 AudioTask::duration(PersonData person) {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
   if (!user.enable_audio) return 0;
 
-  auto instance = get_instance();
+  auto task = get_instance();
+  AudioPriority priority;
+  auto clips = task->report_clips(person, priority);
+
+  // load_audio may be replacing the clips
   SZ_UINT16 total_duration = 0;
+  std::unique_lock<std::mutex> lock(task->mutex_);
+  for (auto audio : clips) total_duration += audio->duration;
+
+  return total_duration / 1000 + 1;
+}
+
+std::vector<const Audio*> AudioTask::report_clips(PersonData& person,
+                                                  AudioPriority& priority) {
+  auto &user = Config::get_user();
+  std::vector<const Audio*> clips;
+  priority = AUDIO_PRIORITY_RESULT;
 
-  if (user.enable_record_audio && !person.is_status_normal())
-    total_duration += instance->fail_audio_.duration;
+  if (user.enable_record_audio && !person.is_status_normal()) {
+    clips.push_back(&fail_audio_);
+    priority = AUDIO_PRIORITY_ALARM;
+  }
 
   if (user.enable_mask_audio && !person.has_mask)
-    total_duration += instance->warn_mask_audio_.duration;
+    clips.push_back(&warn_mask_audio_);
 
   if (Config::display_temperature()) {
     if (user.enable_temperature_audio) {
-      if (!person.is_temperature_normal())
-        total_duration += instance->temperature_abnormal_audio_.duration;
-      else
-        total_duration += instance->temperature_normal_audio_.duration;
+      if (!person.is_temperature_normal()) {
+        clips.push_back(&temperature_abnormal_audio_);
+        priority = AUDIO_PRIORITY_ALARM;
+      } else {
+        clips.push_back(&temperature_normal_audio_);
+      }
     }
   }
 
   if (user.enable_pass_audio && GPIOTask::validate(person))
-    total_duration += instance->pass_audio_.duration;
+    clips.push_back(&pass_audio_);
 
-  // SZ_LOG_INFO("total_duration={}", total_duration / 1000);
-  return total_duration / 1000 + 1;
+  return clips;
 }
 
-AudioTask::AudioTask(QThread* thread, QObject* parent) : is_running_(false) {
+const Audio* AudioTask::combine_locked(
+    const std::vector<const Audio*>& clips) {
+  if (clips.size() == 1) return clips[0];
+
+  // ADTS frames are self-contained, so the streams are simply appended
+  auto it = combined_audio_.find(clips);
+  if (it == combined_audio_.end()) {
+    Audio audio = {{}, 0};
+    for (auto clip : clips) {
+      if (clip->duration <= 0) continue;
+      audio.data.insert(audio.data.end(), clip->data.begin(), clip->data.end());
+      audio.duration += clip->duration;
+    }
+    it = combined_audio_.emplace(clips, std::move(audio)).first;
+  }
+  return &it->second;
+}
+
+AudioTask::AudioTask(QThread* thread, QObject* parent)
+    : playing_(false),
+      current_({nullptr, AUDIO_PRIORITY_PROMPT, nullptr}),
+      is_running_(false) {
   // Load volume
   int volume_percent = 100;
   if (!Config::read_audio_volume(volume_percent)) {
@@ -61,11 +104,15 @@ AudioTask::AudioTask(QThread* thread, QObject* parent) : is_running_(false) {
   // Load audio resources
   load_audio();
 
-  // Create thread
+  // A child, so it moves to the audio thread with the task
+  play_timer_ = new QTimer(this);
+  play_timer_->setSingleShot(true);
+  play_timer_->setTimerType(Qt::PreciseTimer);
+  connect(play_timer_, SIGNAL(timeout()), this, SLOT(rx_finished()));
+
+  // Playing never blocks, so the thread of the lane is shared
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_IO);
   } else {
     moveToThread(thread);
     thread->start();
@@ -75,70 +122,193 @@ AudioTask::AudioTask(QThread* thread, QObject* parent) : is_running_(false) {
 AudioTask::~AudioTask() {}
 
 void AudioTask::beep() {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
   if (!user.enable_audio) return;
 
+  play(beep_audio_, AUDIO_PRIORITY_PROMPT);
+}
+
+void AudioTask::play(const Audio& audio, AudioPriority priority,
+                     Callback done) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    play_locked(&audio, priority, done);
+  }
+
+  QMetaObject::invokeMethod(this, "rx_schedule", Qt::QueuedConnection);
+}
+
+void AudioTask::play_locked(const Audio* audio, AudioPriority priority,
+                            Callback done) {
+  bool coalesced = false;
+  if (priority == AUDIO_PRIORITY_PROMPT) {
+    coalesced = playing_ && current_.audio == audio;
+    for (auto& clip : queues_[priority]) coalesced |= clip.audio == audio;
+  } else {
+    drop_locked(AUDIO_PRIORITY_PROMPT);
+  }
+
+  if (coalesced)
+    finished_.push_back(done);
+  else
+    queues_[priority].push_back({audio, priority, done});
   is_running_ = true;
-  play_audio(beep_audio_);
-  is_running_ = false;
 }
 
-void AudioTask::load_audio() {
-  std::string lang = Config::get_user_lang();
-  std::string prefix = ":asserts/" + lang;
-  SZ_LOG_INFO("Load audio for lang={}", lang);
+void AudioTask::on_idle(Callback done) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_idle_callbacks_.push_back(done);
+  }
 
-  read_audio(prefix + "/recognition_succeed.aac", success_audio_);
-  read_audio(prefix + "/recognition_failed.aac", fail_audio_);
+  // Registered through the event queue, so the clips requested by queued
+  // signals before this call are in the queue when it is checked
+  QMetaObject::invokeMethod(this, "rx_idle_callback", Qt::QueuedConnection);
+}
 
-  read_audio(prefix + "/temperature_normal.aac", temperature_normal_audio_);
-  read_audio(prefix + "/temperature_abnormal.aac", temperature_abnormal_audio_);
+void AudioTask::rx_idle_callback() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_callbacks_.push_back(pending_idle_callbacks_.front());
+    pending_idle_callbacks_.pop_front();
+  }
 
-  read_audio(prefix + "/get_closer.aac", warn_distance_audio_);
-  read_audio(prefix + "/take_on_mask.aac", warn_mask_audio_);
+  rx_schedule();
+}
 
-  read_audio(prefix + "/pass.aac", pass_audio_);
+void AudioTask::drop_locked(AudioPriority priority) {
+  for (auto& clip : queues_[priority]) finished_.push_back(clip.done);
+  queues_[priority].clear();
+}
 
-  if (lang == "en") {
-    success_audio_.duration = 1500;
-    fail_audio_.duration = 1500;
+void AudioTask::rx_schedule() {
+  std::vector<Callback> callbacks;
+  int duration = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    callbacks.swap(finished_);
+
+    // The most urgent clip which has anything to play
+    for (int p = AUDIO_PRIORITY_COUNT - 1; !playing_ && p >= 0; p--) {
+      auto& queue = queues_[p];
+      while (!playing_ && !queue.empty()) {
+        Clip clip = queue.front();
+        queue.pop_front();
+        if (clip.audio->duration > 0) {
+          current_ = clip;
+          playing_ = true;
+          duration = clip.audio->duration;
+        } else {
+          callbacks.push_back(clip.done);
+        }
+      }
+    }
 
-    temperature_normal_audio_.duration = 1000;
-    temperature_abnormal_audio_.duration = 1500;
+    // audio_play copies the stream, it is started with mutex_ held as
+    // load_audio may replace the clip once it is released
+    if (duration > 0) io::Engine::instance()->audio_play(current_.audio->data);
 
-    warn_distance_audio_.duration = 1500;
-    warn_mask_audio_.duration = 2000;
+    if (!playing_) {
+      callbacks.insert(callbacks.end(), idle_callbacks_.begin(),
+                       idle_callbacks_.end());
+      idle_callbacks_.clear();
+      is_running_ = false;
+    }
+  }
 
-    pass_audio_.duration = 1000;
-  } else if (lang == "zh-CN") {
-    success_audio_.duration = 1000;
-    fail_audio_.duration = 1000;
+  if (duration > 0) play_timer_->start(duration);
 
-    temperature_normal_audio_.duration = 2000;
-    temperature_abnormal_audio_.duration = 2000;
+  for (auto& callback : callbacks) {
+    if (callback) callback();
+  }
+}
 
-    warn_distance_audio_.duration = 2000;
-    warn_mask_audio_.duration = 1000;
+void AudioTask::rx_finished() {
+  Callback done;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done = current_.done;
+    current_ = {nullptr, AUDIO_PRIORITY_PROMPT, nullptr};
+    playing_ = false;
+  }
 
-    pass_audio_.duration = 1000;
-  } else if (lang == "jp") {
-    success_audio_.duration = 0;
-    fail_audio_.duration = 1500;
+  if (done) done();
+  rx_schedule();
+}
 
-    temperature_normal_audio_.duration = 1500;
-    temperature_abnormal_audio_.duration = 1500;
+void AudioTask::load_audio() {
+  std::string lang = Config::get_user_lang();
+  std::string prefix = ":asserts/" + lang;
+  SZ_LOG_INFO("Load audio for lang={}", lang);
 
-    warn_distance_audio_.duration = 3000;
-    warn_mask_audio_.duration = 1500;
+  // Called by the config listener while the audio thread plays the clips, so
+  // they are read aside and swapped in with mutex_ held
+  const std::pair<std::string, Audio*> clips[] = {
+      {prefix + "/recognition_succeed.aac", &success_audio_},
+      {prefix + "/recognition_failed.aac", &fail_audio_},
+      {prefix + "/temperature_normal.aac", &temperature_normal_audio_},
+      {prefix + "/temperature_abnormal.aac", &temperature_abnormal_audio_},
+      {prefix + "/get_closer.aac", &warn_distance_audio_},
+      {prefix + "/take_on_mask.aac", &warn_mask_audio_},
+      {prefix + "/pass.aac", &pass_audio_},
+      {":asserts/beep.aac", &beep_audio_},
+  };
+  const size_t count = sizeof(clips) / sizeof(clips[0]);
+  std::vector<Audio> loaded(count);
+  for (size_t i = 0; i < count; i++) read_audio(clips[i].first, loaded[i]);
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < count; i++) std::swap(*clips[i].second, loaded[i]);
+
+    // The queue may still point to the combinations of the previous language
+    for (int p = 0; p < AUDIO_PRIORITY_COUNT; p++)
+      drop_locked((AudioPriority)p);
+    combined_audio_.clear();
+  }
+  QMetaObject::invokeMethod(this, "rx_schedule", Qt::QueuedConnection);
+}
 
-    pass_audio_.duration = 2500;
+// Sums the samples of the ADTS frames of an AAC stream, an ID3 tag in front
+// of the stream is skipped
+int AudioTask::adts_duration(const std::vector<SZ_BYTE>& data) {
+  static const int SAMPLE_RATES[] = {96000, 88200, 64000, 48000, 44100,
+                                     32000, 24000, 22050, 16000, 12000,
+                                     11025, 8000,  7350};
+  const size_t HEADER_SIZE = 7;
+  const size_t ID3_HEADER_SIZE = 10;
+
+  size_t pos = 0;
+  const SZ_BYTE* d = data.data();
+  if (data.size() >= ID3_HEADER_SIZE && d[0] == 'I' && d[1] == 'D' &&
+      d[2] == '3') {
+    pos = ID3_HEADER_SIZE + ((d[6] & 0x7f) << 21 | (d[7] & 0x7f) << 14 |
+                             (d[8] & 0x7f) << 7 | (d[9] & 0x7f));
   }
 
-  read_audio(":asserts/beep.aac", beep_audio_);
-  beep_audio_.duration = 250;
+  int64_t duration_us = 0;
+  while (pos + HEADER_SIZE <= data.size()) {
+    const SZ_BYTE* h = d + pos;
+    if (h[0] != 0xff || (h[1] & 0xf6) != 0xf0) break;
+
+    int rate_index = (h[2] >> 2) & 0x0f;
+    size_t frame_length = (h[3] & 0x03) << 11 | h[4] << 3 | h[5] >> 5;
+    int blocks = (h[6] & 0x03) + 1;
+    if (rate_index >= (int)(sizeof(SAMPLE_RATES) / sizeof(int)) ||
+        frame_length < HEADER_SIZE)
+      break;
+
+    duration_us += 1024 * blocks * 1000000LL / SAMPLE_RATES[rate_index];
+    pos += frame_length;
+  }
+  return duration_us / 1000;
 }
 
 bool AudioTask::read_audio(const std::string& name, Audio& audio) {
+  // A missing clip is silent, as some languages have no clip for a result
+  audio.data.clear();
+  audio.duration = 0;
+
   QFile audio_file(name.c_str());
   if (!audio_file.open(QIODevice::ReadOnly)) {
     SZ_LOG_ERROR("Open {} failed", name);
@@ -146,50 +316,36 @@ bool AudioTask::read_audio(const std::string& name, Audio& audio) {
   }
   auto data = audio_file.readAll();
   audio.data.assign(data.begin(), data.end());
+  audio.duration = adts_duration(audio.data);
+  if (audio.duration == 0) SZ_LOG_WARN("No ADTS frame in {}", name);
   return true;
 }
 
-void AudioTask::play_audio(Audio& audio) {
-  if (audio.duration > 0) {
-    io::Engine::instance()->audio_play(audio.data);
-    QThread::msleep(audio.duration);
-  }
-}
-
 void AudioTask::rx_report(PersonData person, bool audio_duplicated,
                           bool record_duplicated) {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
   if (!user.enable_audio || audio_duplicated) return;
 
-  is_running_ = true;
-
-  if (user.enable_record_audio && !person.is_status_normal())
-    play_audio(fail_audio_);
-
-  if (user.enable_mask_audio && !person.has_mask) play_audio(warn_mask_audio_);
-
-  if (Config::display_temperature()) {
-    if (user.enable_temperature_audio) {
-      if (!person.is_temperature_normal())
-        play_audio(temperature_abnormal_audio_);
-      else
-        play_audio(temperature_normal_audio_);
-    }
+  // Played as one clip without gaps, an alarm in it makes it an alarm
+  AudioPriority priority;
+  auto clips = report_clips(person, priority);
+
+  // The combination is queued under the same lock it is found with, as
+  // load_audio clears the combinations
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // The results of the previous person are stale
+    drop_locked(AUDIO_PRIORITY_RESULT);
+    if (!clips.empty()) play_locked(combine_locked(clips), priority, nullptr);
   }
-
-  if (user.enable_pass_audio && GPIOTask::validate(person))
-    play_audio(pass_audio_);
-
-  is_running_ = false;
+  QMetaObject::invokeMethod(this, "rx_schedule", Qt::QueuedConnection);
 }
 
 void AudioTask::rx_warn_distance() {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
   if (!user.enable_audio || !user.enable_distance_audio ||
       !Config::display_temperature())
     return;
 
-  is_running_ = true;
-  play_audio(warn_distance_audio_);
-  is_running_ = false;
+  play(warn_distance_audio_, AUDIO_PRIORITY_PROMPT);
 }
@@ -1,42 +1,95 @@
 #ifndef AUDIO_TASK_HPP
 #define AUDIO_TASK_HPP
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
 #include <mutex>
 #include <vector>
 
 #include <QObject>
 #include <QThread>
+#include <QTimer>
 
 #include "person_service.hpp"
 
 namespace suanzi {
 
+// An AAC clip with ADTS headers, duration in milliseconds
 struct Audio {
   std::vector<SZ_BYTE> data;
   int duration;
 };
 
+// From the least to the most urgent, a more urgent clip is always played
+// first. Results and alarms drop the queued prompts, which are stale by the
+// time they would play, and a new report drops the queued results of the
+// previous one.
+typedef enum {
+  AUDIO_PRIORITY_PROMPT = 0,  // distance warning, beep
+  AUDIO_PRIORITY_RESULT,      // recognition and temperature results
+  AUDIO_PRIORITY_ALARM,       // failed recognition, abnormal temperature
+  AUDIO_PRIORITY_COUNT,
+} AudioPriority;
+
+// Plays the clips from a priority queue. Playing never blocks the thread, the
+// next clip is started by a timer once the current one is over, so all the
+// methods return at once and can be called from any thread.
 class AudioTask : QObject {
   Q_OBJECT
  public:
+  typedef std::function<void()> Callback;
+
   static AudioTask* get_instance();
   static bool idle();
   static SZ_UINT16 duration(PersonData person);
 
+  // Safe to call from any thread, the clips are swapped in under mutex_
   void load_audio();
   void beep();
 
+  // done is called on the audio thread once the clip is over or dropped. A
+  // prompt already queued or playing is not queued again.
+  void play(const Audio& audio, AudioPriority priority,
+            Callback done = nullptr);
+
+  // done is called on the audio thread once the queue is empty, after the
+  // clips already requested, also by queued signals, have been played
+  void on_idle(Callback done);
+
  private slots:
   void rx_report(PersonData person, bool audio_duplicated,
                  bool record_duplicated);
   void rx_warn_distance();
+  void rx_schedule();
+  void rx_finished();
+  void rx_idle_callback();
 
  private:
   AudioTask(QThread* thread = nullptr, QObject* parent = nullptr);
   ~AudioTask();
 
+  struct Clip {
+    const Audio* audio;
+    AudioPriority priority;
+    Callback done;
+  };
+
   bool read_audio(const std::string& name, Audio& audio);
-  void play_audio(Audio& audio);
+  static int adts_duration(const std::vector<SZ_BYTE>& data);
+
+  // The clips announcing person in the order they are played, priority is
+  // the highest of them
+  std::vector<const Audio*> report_clips(PersonData& person,
+                                         AudioPriority& priority);
+  // The clips appended into one, kept until the language changes. With
+  // mutex_ held, which has to stay held until the clip is queued.
+  const Audio* combine_locked(const std::vector<const Audio*>& clips);
+  // Queues audio as play() does, with mutex_ held
+  void play_locked(const Audio* audio, AudioPriority priority, Callback done);
+  // Moves the queued clips of priority to finished_, with mutex_ held
+  void drop_locked(AudioPriority priority);
 
   Audio pass_audio_;
 
@@ -49,7 +102,18 @@ class AudioTask : QObject {
 
   Audio beep_audio_;
 
-  bool is_running_;
+  std::mutex mutex_;
+  std::deque<Clip> queues_[AUDIO_PRIORITY_COUNT];
+  std::map<std::vector<const Audio*>, Audio> combined_audio_;
+  // Callbacks of the clips dropped or skipped, called by rx_schedule
+  std::vector<Callback> finished_;
+  std::deque<Callback> pending_idle_callbacks_;
+  std::vector<Callback> idle_callbacks_;
+  bool playing_;
+  Clip current_;
+  QTimer* play_timer_;
+
+  std::atomic<bool> is_running_;
 };
 
 }  // namespace suanzi
@@ -0,0 +1,98 @@
+#include "camera_capturer.hpp"
+
+#include <chrono>
+
+#include "task_executor.hpp"
+
+using namespace suanzi;
+using namespace suanzi::io;
+
+constexpr int CameraCapturer::FRAME_INTERVAL_MS;
+constexpr int CameraCapturer::CAPTURE_RETRY_INTERVAL_MS;
+
+CameraCapturer::CameraCapturer(CameraType camera, QObject *parent)
+    : camera_(camera),
+      requested_(false),
+      done_(false),
+      stopping_(false),
+      succeed_(false),
+      pts_(0),
+      small_(nullptr),
+      large_(nullptr) {
+  start();
+}
+
+CameraCapturer::~CameraCapturer() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  QThread::wait();
+}
+
+int64_t CameraCapturer::now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void CameraCapturer::request(MmzImage *small, MmzImage *large) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    small_ = small;
+    large_ = large;
+    requested_ = true;
+    done_ = false;
+  }
+  cond_.notify_all();
+}
+
+bool CameraCapturer::wait(int64_t &pts) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return done_ || stopping_; });
+  pts = pts_;
+  return done_ && succeed_;
+}
+
+bool CameraCapturer::capture_channel(int channel, MmzImage *image) {
+  auto engine = Engine::instance();
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(FRAME_INTERVAL_MS);
+
+  // VPSS has no frame ready yet: sleep a fraction of the frame period instead
+  // of spinning, and give up once a whole frame period has passed
+  while (engine->capture_frame(camera_, channel, *image) != SZ_RETCODE_OK) {
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    QThread::msleep(CAPTURE_RETRY_INTERVAL_MS);
+  }
+  return true;
+}
+
+void CameraCapturer::run() {
+  TaskExecutor::pin_current_thread(LANE_CAPTURE);
+
+  while (true) {
+    MmzImage *small, *large;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return requested_ || stopping_; });
+      if (stopping_) break;
+      requested_ = false;
+      small = small_;
+      large = large_;
+    }
+
+    bool succeed = capture_channel(2, small);
+    int64_t pts = now_us();
+    succeed = succeed && capture_channel(1, large);
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      succeed_ = succeed;
+      pts_ = pts;
+      done_ = true;
+    }
+    cond_.notify_all();
+  }
+}
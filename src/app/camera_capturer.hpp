@@ -0,0 +1,54 @@
+#ifndef CAMERA_CAPTURER_H
+#define CAMERA_CAPTURER_H
+
+#include <QThread>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include <quface-io/engine.hpp>
+#include <quface-io/mmzimage.hpp>
+
+namespace suanzi {
+
+// Captures the small and large VPSS channels of one camera on its own thread,
+// so that BGR and NIR frames are grabbed at the same moment
+class CameraCapturer : QThread {
+  Q_OBJECT
+
+ public:
+  CameraCapturer(io::CameraType camera, QObject *parent = nullptr);
+  ~CameraCapturer();
+
+  // Start capturing into the given images, returns immediately
+  void request(io::MmzImage *small, io::MmzImage *large);
+
+  // Wait for the pending request, pts is the capture time in microseconds
+  bool wait(int64_t &pts);
+
+  static int64_t now_us();
+
+ private:
+  void run() override;
+  bool capture_channel(int channel, io::MmzImage *image);
+
+  // Frame period of the 30fps sensors, used as the upper bound of every wait
+  static constexpr int FRAME_INTERVAL_MS = 33;
+  static constexpr int CAPTURE_RETRY_INTERVAL_MS = 2;
+
+  io::CameraType camera_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool requested_;
+  bool done_;
+  bool stopping_;
+  bool succeed_;
+  int64_t pts_;
+  io::MmzImage *small_;
+  io::MmzImage *large_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -1,6 +1,7 @@
 #include "camera_reader.hpp"
 
 #include <chrono>
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
 #include <regex>
@@ -8,6 +9,9 @@
 using namespace suanzi;
 using namespace suanzi::io;
 
+constexpr int64_t CameraReader::MAX_PTS_DIFF_US;
+constexpr int CameraReader::MAX_PAIRING_TRIALS;
+
 CameraReader *CameraReader::get_instance() {
   static CameraReader instance;
   return &instance;
@@ -35,13 +39,23 @@ CameraReader::CameraReader(QObject *parent) {
   pingpang_buffer_ =
       new PingPangBuffer<ImagePackage>(buffer_ping_, buffer_pang_);
 
+  bgr_capturer_ = new CameraCapturer(CAMERA_BGR);
+  nir_capturer_ = new CameraCapturer(CAMERA_NIR);
+
   rx_finished_ = true;
+  stopping_ = false;
 }
 
 CameraReader::~CameraReader() {
+  // The capturers are used by run(), which ends within a capture
+  stopping_ = true;
+  wait();
+
   if (buffer_ping_) delete buffer_ping_;
   if (buffer_pang_) delete buffer_pang_;
   if (pingpang_buffer_) delete pingpang_buffer_;
+  if (bgr_capturer_) delete bgr_capturer_;
+  if (nir_capturer_) delete nir_capturer_;
 }
 
 bool CameraReader::get_screen_size(int &width, int &height) {
@@ -61,30 +75,34 @@ void CameraReader::start_sample() { start(); }
 void CameraReader::rx_finish() { rx_finished_ = true; }
 
 bool CameraReader::capture_frame(ImagePackage *pkg) {
-  auto engine = Engine::instance();
   static int frame_idx = 0;
-
-  SZ_RETCODE ret;
-
-  {
-    ret = engine->capture_frame(io::CAMERA_BGR, 2, *pkg->img_bgr_small);
-    if (ret != SZ_RETCODE_OK) return false;
-
-    ret = SZ_RETCODE_FAILED;
-    while (ret != SZ_RETCODE_OK) {
-      ret = engine->capture_frame(io::CAMERA_BGR, 1, *pkg->img_bgr_large);
-      QThread::usleep(10);
+  static int unpaired = 0;
+
+  // Both cameras are captured at the same time on their own threads
+  bgr_capturer_->request(pkg->img_bgr_small, pkg->img_bgr_large);
+  nir_capturer_->request(pkg->img_nir_small, pkg->img_nir_large);
+  bool bgr_ok = bgr_capturer_->wait(pkg->bgr_pts);
+  bool nir_ok = nir_capturer_->wait(pkg->nir_pts);
+  if (!bgr_ok || !nir_ok) return false;
+
+  // The sensors are not hardware synchronized: when the pair drifted apart,
+  // the earlier camera is captured again so its next frame catches up
+  for (int i = 0; i < MAX_PAIRING_TRIALS &&
+                  std::abs(pkg->bgr_pts - pkg->nir_pts) > MAX_PTS_DIFF_US;
+       i++) {
+    if (pkg->bgr_pts < pkg->nir_pts) {
+      bgr_capturer_->request(pkg->img_bgr_small, pkg->img_bgr_large);
+      if (!bgr_capturer_->wait(pkg->bgr_pts)) return false;
+    } else {
+      nir_capturer_->request(pkg->img_nir_small, pkg->img_nir_large);
+      if (!nir_capturer_->wait(pkg->nir_pts)) return false;
     }
   }
-  {
-    ret = engine->capture_frame(io::CAMERA_NIR, 2, *pkg->img_nir_small);
-    if (ret != SZ_RETCODE_OK) return false;
-
-    ret = SZ_RETCODE_FAILED;
-    while (ret != SZ_RETCODE_OK) {
-      ret = engine->capture_frame(io::CAMERA_NIR, 1, *pkg->img_nir_large);
-      QThread::usleep(10);
-    }
+
+  if (std::abs(pkg->bgr_pts - pkg->nir_pts) > MAX_PTS_DIFF_US &&
+      ++unpaired % 100 == 0) {
+    SZ_LOG_DEBUG("{} frames with BGR/NIR pts diff over {}us", unpaired,
+                 MAX_PTS_DIFF_US);
   }
 
   pkg->frame_idx = frame_idx++;
@@ -92,20 +110,53 @@ bool CameraReader::capture_frame(ImagePackage *pkg) {
   return true;
 }
 
+// CPU time of all the threads of the process, to report the load of capture
+static int64_t process_cpu_us() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void CameraReader::run() {
-  while (!capture_frame(pingpang_buffer_->get_pang()))
+  TaskExecutor::pin_current_thread(LANE_CAPTURE);
+
+  while (!stopping_ && !capture_frame(pingpang_buffer_->get_pang()))
     ;
-  while (!capture_frame(pingpang_buffer_->get_ping()))
+  while (!stopping_ && !capture_frame(pingpang_buffer_->get_ping()))
     ;
 
-  while (true) {
-    ImagePackage *output = pingpang_buffer_->get_ping();
+  // DetectTask switches the buffers when it takes a frame, which may be after
+  // the next capture has started, so the free buffer is tracked here
+  ImagePackage *target = pingpang_buffer_->get_ping();
+  bool captured = true;
+
+  int emitted = 0, failed = 0;
+  int64_t cpu_start = process_cpu_us();
+  int64_t wall_start = CameraCapturer::now_us();
+  while (!stopping_) {
+    // The free buffer is refilled until DetectTask has released the previous
+    // frame, so the frame handed over is never older than one capture. Each
+    // capture blocks on the sensor, so this does not spin.
+    if (!captured || !rx_finished_) {
+      captured = capture_frame(target);
+      if (!captured) failed++;
+      continue;
+    }
 
-    if (capture_frame(output) && rx_finished_) {
-      rx_finished_ = false;
-      emit tx_frame(pingpang_buffer_);
-    } else {
-      QThread::usleep(10);
+    rx_finished_ = false;
+    emit tx_frame(pingpang_buffer_);
+    target = target == buffer_ping_ ? buffer_pang_ : buffer_ping_;
+    captured = false;
+
+    if (++emitted % 300 == 0) {
+      int64_t cpu_end = process_cpu_us();
+      int64_t wall_end = CameraCapturer::now_us();
+      SZ_LOG_DEBUG(
+          "captured {} frames, {} capture timeouts, process cpu {:.1f}%",
+          emitted, failed,
+          100. * (cpu_end - cpu_start) / (wall_end - wall_start));
+      cpu_start = cpu_end;
+      wall_start = wall_end;
     }
   }
 }
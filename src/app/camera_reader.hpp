@@ -4,13 +4,15 @@
 #include <QImage>
 #include <QSharedPointer>
 #include <QThread>
-#include <chrono>
+#include <atomic>
 
 #include <quface-io/engine.hpp>
 
+#include "camera_capturer.hpp"
 #include "config.hpp"
 #include "image_package.hpp"
 #include "pingpang_buffer.hpp"
+#include "task_executor.hpp"
 
 namespace suanzi {
 
@@ -37,7 +39,14 @@ class CameraReader : QThread {
   void run();
   bool capture_frame(ImagePackage *pkg);
 
-  bool rx_finished_;
+  // BGR and NIR frames captured further apart than this are re-paired
+  static constexpr int64_t MAX_PTS_DIFF_US = 15000;
+  static constexpr int MAX_PAIRING_TRIALS = 2;
+
+  CameraCapturer *bgr_capturer_, *nir_capturer_;
+
+  std::atomic<bool> rx_finished_;
+  std::atomic<bool> stopping_;
 
   ImagePackage *buffer_ping_, *buffer_pang_;
   PingPangBuffer<ImagePackage> *pingpang_buffer_;
@@ -12,9 +12,10 @@
 
 #include "audio_task.hpp"
 #include "config.hpp"
+#include "model_registry.hpp"
 #include "recognize_task.hpp"
 #include "record_task.hpp"
-#include "temperature_task.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 
@@ -25,15 +26,13 @@ DetectTask *DetectTask::get_instance() {
 
 DetectTask::DetectTask(QThread *thread, QObject *parent)
     : buffer_inited_(false) {
-  auto cfg = Config::get_quface();
-  face_detector_ = std::make_shared<FaceDetector>(cfg.model_file_path);
-  pose_estimator_ = std::make_shared<FacePoseEstimator>(cfg.model_file_path);
+  auto models = ModelRegistry::get_instance();
+  face_detector_ = models->detector();
+  pose_estimator_ = models->pose_estimator();
 
   // Create thread
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_DETECT);
   } else {
     moveToThread(thread);
     thread->start();
@@ -47,7 +46,7 @@ DetectTask::~DetectTask() {
 }
 
 void DetectTask::rx_frame(PingPangBuffer<ImagePackage> *buffer) {
-  auto cfg = Config::get_detect();
+  auto &cfg = Config::get_detect();
 
   buffer->switch_buffer();
   ImagePackage *input = buffer->get_pang();
@@ -71,9 +70,10 @@ void DetectTask::rx_frame(PingPangBuffer<ImagePackage> *buffer) {
   emit tx_bgr_display(output->bgr_detection_, !output->bgr_face_detected_,
                       output->bgr_face_valid_, true);
 
-  if (TemperatureTask::get_instance()->idle())
-    emit tx_temperature_target(output->bgr_detection_,
-                               !output->bgr_face_detected_);
+  // Every detection, the temperature task pairs each thermal frame with the
+  // one nearest to it
+  emit tx_temperature_target(output->bgr_detection_,
+                             !output->bgr_face_detected_, output->bgr_pts);
 
   output->nir_face_detected_ =
       detect_and_select(input->img_nir_small, output->nir_detection_, false);
@@ -93,8 +93,6 @@ void DetectTask::rx_frame(PingPangBuffer<ImagePackage> *buffer) {
 
   if (RecognizeTask::idle() && (valid_dectect || RecordTask::card_readed()))
     emit tx_frame_for_recognize(pingpang_buffer_);
-  else
-    QThread::usleep(10);
 
   emit tx_detect_result(valid_dectect);  // fire FaceTimer event
   emit tx_finish();
@@ -102,7 +100,7 @@ void DetectTask::rx_frame(PingPangBuffer<ImagePackage> *buffer) {
 
 bool DetectTask::detect_and_select(const MmzImage *image,
                                    DetectionRatio &detection, bool is_bgr) {
-  auto cfg = Config::get_detect();
+  auto &cfg = Config::get_detect();
 
   // skip broken image
   int width = ((const SVP_IMAGE_S *)image->pImplData)->u32Width;
@@ -128,15 +126,13 @@ bool DetectTask::detect_and_select(const MmzImage *image,
   if (detections.size() == 0) return false;
 
   // select largest face
-  int max_id = 0;
-  float max_area = detections[0].bbox.width * detections[0].bbox.height;
-  for (int i = 1; i < detections.size(); i++) {
-    float area = detections[i].bbox.width * detections[i].bbox.height;
-    if (area > max_area) {
-      max_id = i;
-      max_area = area;
-    }
+  static geometry::BoxArray boxes;
+  boxes.clear();
+  for (auto &it : detections) {
+    boxes.push_back({(float)it.bbox.x, (float)it.bbox.y, (float)it.bbox.width,
+                     (float)it.bbox.height});
   }
+  int max_id = geometry::select_largest(boxes);
 
   float prob_threshold = is_bgr ? 0.9 : 0.75;
   ret = pose_estimator_->estimate((const SVP_IMAGE_S *)image->pImplData,
@@ -168,14 +164,17 @@ bool DetectTask::detect_and_select(const MmzImage *image,
 }
 
 bool DetectTask::check(DetectionRatio detection, bool is_bgr) {
-  if (!detection.is_valid_pose()) return false;
+  auto snapshot = Config::get_snapshot();
+  auto &cfg = *snapshot;
+
+  if (!detection.is_valid_pose(cfg)) return false;
 
   if (is_bgr) {
-    if (!is_stable(detection)) return false;
+    if (!is_stable(detection, cfg.detect)) return false;
 
     static int invalid_count = 0;
-    if (!detection.is_valid_position() || !detection.is_valid_size()) {
-      if (Config::get_user().enable_temperature) {
+    if (!detection.is_valid_position(cfg) || !detection.is_valid_size(cfg)) {
+      if (cfg.data.user.enable_temperature) {
         if (AudioTask::idle() && invalid_count++ > 20) {
           invalid_count = 0;
           emit tx_warn_distance();
@@ -190,25 +189,15 @@ bool DetectTask::check(DetectionRatio detection, bool is_bgr) {
   return true;
 }
 
-bool DetectTask::is_stable(DetectionRatio detection) {
+bool DetectTask::is_stable(DetectionRatio detection, const DetectConfig &cfg) {
   static int stable_counter = 0;
+  static geometry::Box last = {0, 0, 0, 0};
 
-  static float x1 = 0;
-  static float y1 = 0;
-  static float w1 = 0;
-  static float h1 = 0;
-
-  auto cfg = Config::get_detect();
-
-  float x2 = detection.x, y2 = detection.y;
-  float w2 = detection.width, h2 = detection.height;
-
-  if (x1 > x2 + w2 || y1 > y2 + h2 || x1 + w1 < x2 || y1 + h1 < y2)
+  auto current = detection.box();
+  if (geometry::is_disjoint(last, current))
     stable_counter = 0;
   else {
-    float overlay_w = std::min(x1 + w1, x2 + w2) - std::max(x1, x2);
-    float overlay_h = std::min(y1 + h1, y2 + h2) - std::max(y1, y2);
-    float iou = overlay_w * overlay_h / (w1 * h1 + w2 * h2) * 2;
+    float iou = geometry::dice(last, current);
 
     if (iou >= cfg.min_tracking_iou)
       stable_counter++;
@@ -216,10 +205,7 @@ bool DetectTask::is_stable(DetectionRatio detection) {
       stable_counter = 0;
   }
 
-  x1 = x2;
-  y1 = y2;
-  w1 = w2;
-  h1 = h2;
+  last = current;
 
   return stable_counter >= cfg.min_tracking_number;
 }
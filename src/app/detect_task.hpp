@@ -31,7 +31,8 @@ class DetectTask : QObject {
                       bool show_pose);
 
   // for read temperature
-  void tx_temperature_target(DetectionRatio detection, bool to_clear);
+  void tx_temperature_target(DetectionRatio detection, bool to_clear,
+                             qint64 pts);
 
   // for audio warning
   void tx_warn_distance();
@@ -51,7 +52,7 @@ class DetectTask : QObject {
   bool detect_and_select(const MmzImage *image, DetectionRatio &detection,
                          bool is_bgr);
   bool check(DetectionRatio detection, bool is_bgr);
-  bool is_stable(DetectionRatio detection);
+  bool is_stable(DetectionRatio detection, const DetectConfig &cfg);
 
   FaceDetectorPtr face_detector_;
   FacePoseEstimatorPtr pose_estimator_;
@@ -4,6 +4,7 @@
 
 #include "config.hpp"
 #include "led_task.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -60,4 +61,7 @@ void FaceTimer::white_led_timeout() {
   emit tx_reset();
 }
 
-void FaceTimer::run() { exec(); }
+void FaceTimer::run() {
+  TaskExecutor::pin_current_thread(LANE_IO);
+  exec();
+}
@@ -6,6 +6,7 @@
 #include <quface/logger.hpp>
 
 #include "config.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -16,7 +17,7 @@ GPIOTask* GPIOTask::get_instance() {
 }
 
 bool GPIOTask::validate(PersonData person) {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
 
   bool all_pass = true;
   if (user.relay_switch_cond & RelaySwitchCond::Status)
@@ -51,9 +52,7 @@ void GPIOTask::trigger(SZ_UINT32 duration) {
 GPIOTask::GPIOTask(QThread* thread, QObject* parent) : event_count_(0) {
   // Create thread
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_IO);
   } else {
     moveToThread(thread);
     thread->start();
@@ -64,7 +63,7 @@ GPIOTask::~GPIOTask() {}
 
 void GPIOTask::rx_trigger(PersonData person, bool audio_duplicated,
                           bool record_duplicated) {
-  auto user = Config::get_user();
+  auto &user = Config::get_user();
 
   bool all_pass = GPIOTask::validate(person);
 
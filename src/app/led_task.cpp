@@ -6,6 +6,7 @@
 #include <quface/logger.hpp>
 
 #include "config.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -21,9 +22,7 @@ LEDTask::LEDTask(QThread* thread, QObject* parent)
     : is_running_(false), event_count_(0), status_(false) {
   // Create thread
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_IO);
   } else {
     moveToThread(thread);
     thread->start();
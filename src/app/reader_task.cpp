@@ -6,6 +6,7 @@
 #include <quface-io/engine.hpp>
 
 #include "config.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -25,6 +26,8 @@ ReaderTask::ReaderTask(QThread *thread, QObject *parent) {
 ReaderTask::~ReaderTask() {}
 
 void ReaderTask::run() {
+  TaskExecutor::pin_current_thread(LANE_IO);
+
   unsigned char card_no[100];
   int card_no_len = 0;
 
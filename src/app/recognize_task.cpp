@@ -1,6 +1,8 @@
 #include "recognize_task.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <ctime>
 #include <iostream>
 #include <string>
@@ -10,7 +12,11 @@
 #include <quface/logger.hpp>
 
 #include "config.hpp"
+#include "face_journal.hpp"
+#include "model_registry.hpp"
 #include "record_task.hpp"
+#include "template_manager.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 
@@ -23,12 +29,10 @@ bool RecognizeTask::idle() { return !get_instance()->is_running_; }
 
 RecognizeTask::RecognizeTask(QThread *thread, QObject *parent)
     : is_running_(false) {
-  auto cfg = Config::get_quface();
-  face_database_ = std::make_shared<FaceDatabase>(cfg.db_name);
-
-  face_extractor_ = std::make_shared<FaceExtractor>(cfg.model_file_path);
-  anti_spoofing_ = std::make_shared<FaceAntiSpoofing>(cfg.model_file_path);
-  mask_detector_ = std::make_shared<MaskDetector>(cfg.model_file_path);
+  auto models = ModelRegistry::get_instance();
+  face_extractor_ = models->extractor();
+  anti_spoofing_ = models->anti_spoofing();
+  mask_detector_ = models->mask_detector();
 
   // Initialize PINGPANG buffer
   Size size_bgr_1 = VPSS_CH_SIZES_BGR[1];
@@ -62,9 +66,7 @@ RecognizeTask::RecognizeTask(QThread *thread, QObject *parent)
 
   // Create thread
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_RECOGNIZE);
   } else {
     moveToThread(thread);
     thread->start();
@@ -104,19 +106,23 @@ void RecognizeTask::rx_frame(PingPangBuffer<DetectionData> *buffer) {
         output->is_live = is_live(input);
     }
     if (output->has_person_info) {
-      output->has_mask = has_mask(input);
-      extract_and_query(input, output->has_mask, output->person_feature,
-                        output->person_info);
+      int width = input->img_bgr_large->width;
+      int height = input->img_bgr_large->height;
+
+      suanzi::FaceDetection face_detection;
+      suanzi::FacePose pose;
+      input->bgr_detection_.scale(width, height, face_detection, pose);
+
+      output->has_mask = has_mask(input, face_detection);
+      extract_and_query(input, face_detection, pose, output->has_mask,
+                        output->person_feature, output->person_info);
     }
   } else {
     output->has_live = false;
     output->has_person_info = false;
   }
 
-  if (RecordTask::idle())
-    emit tx_frame(pingpang_buffer_);
-  else
-    QThread::usleep(10);
+  if (RecordTask::idle()) emit tx_frame(pingpang_buffer_);
 
   is_running_ = false;
 }
@@ -152,14 +158,8 @@ bool RecognizeTask::is_live(DetectionData *detection) {
     return false;
 }
 
-bool RecognizeTask::has_mask(DetectionData *detection) {
-  int width = detection->img_bgr_large->width;
-  int height = detection->img_bgr_large->height;
-
-  suanzi::FaceDetection face_detection;
-  suanzi::FacePose pose;
-  detection->bgr_detection_.scale(width, height, face_detection, pose);
-
+bool RecognizeTask::has_mask(DetectionData *detection,
+                             const FaceDetection &face_detection) {
   SZ_BOOL has_mask;
   SZ_RETCODE ret = mask_detector_->classify(
       (const SVP_IMAGE_S *)detection->img_bgr_large->pImplData, face_detection,
@@ -171,16 +171,19 @@ bool RecognizeTask::has_mask(DetectionData *detection) {
     return false;
 }
 
-void RecognizeTask::extract_and_query(DetectionData *detection, bool has_mask,
+SZ_FLOAT RecognizeTask::masked_gallery_score(SZ_FLOAT score) {
+  // Empirical stretch of the scores above 0.5, it is only needed until the
+  // person has learned masked templates. The scores below are dissimilar
+  // faces, they are kept as they are, where the power is not defined.
+  if (score <= 0.5) return score;
+  return pow(std::min((score - 0.5f) * 2, 1.f), 0.45) / 2 + 0.5;
+}
+
+void RecognizeTask::extract_and_query(DetectionData *detection,
+                                      const FaceDetection &face_detection,
+                                      const FacePose &pose, bool has_mask,
                                       FaceFeature &feature,
                                       QueryResult &person_info) {
-  int width = detection->img_bgr_large->width;
-  int height = detection->img_bgr_large->height;
-
-  suanzi::FaceDetection face_detection;
-  suanzi::FacePose pose;
-  detection->bgr_detection_.scale(width, height, face_detection, pose);
-
   // extract: 25ms
   SZ_RETCODE ret = face_extractor_->extract(
       (const SVP_IMAGE_S *)detection->img_bgr_large->pImplData, face_detection,
@@ -191,13 +194,33 @@ void RecognizeTask::extract_and_query(DetectionData *detection, bool has_mask,
     static std::vector<suanzi::QueryResult> results;
     results.clear();
 
-    ret = face_database_->query(feature, 1, results);
+    ret = FaceJournal::get_instance()->query(feature, 1, results);
     if (SZ_RETCODE_OK == ret) {
-      if (has_mask)
-        person_info.score = pow((results[0].score - 0.5) * 2, 0.45) / 2 + 0.5;
-      else
-        person_info.score = results[0].score;
+      person_info.score = results[0].score;
       person_info.face_id = results[0].face_id;
+    }
+
+    // The gallery and the templates are compared on the raw similarity.
+    // Templates are learned in the same mask state, their score is used as
+    // it is; a masked face matched by the gallery is stretched afterwards.
+    auto templates = TemplateManager::get_instance();
+    SZ_UINT32 template_face_id;
+    SZ_FLOAT template_score;
+    if (templates->query(feature, has_mask, template_face_id,
+                         template_score) &&
+        (SZ_RETCODE_OK != ret || template_score > person_info.score)) {
+      person_info.face_id = template_face_id;
+      person_info.score = template_score;
+      ret = SZ_RETCODE_OK;
+
+      // Only a template which supplies an accepted match counts as useful
+      if (template_score >= Config::get_extract().min_recognize_score)
+        templates->hit(template_face_id, feature, has_mask);
+    } else if (SZ_RETCODE_OK == ret && has_mask) {
+      person_info.score = masked_gallery_score(person_info.score);
+    }
+
+    if (SZ_RETCODE_OK == ret) {
       // SZ_LOG_INFO("mask={}, id={}, score={:.2f}", has_mask,
       // person_info.face_id,
       //             person_info.score);
@@ -30,10 +30,17 @@ class RecognizeTask : QObject {
   ~RecognizeTask();
 
   bool is_live(DetectionData *detection);
-  bool has_mask(DetectionData *detection);
-  void extract_and_query(DetectionData *detection, bool has_mask,
+  // The face is located on the large bgr image once and shared by the mask
+  // classifier and the extractor
+  bool has_mask(DetectionData *detection, const FaceDetection &face_detection);
+  void extract_and_query(DetectionData *detection,
+                         const FaceDetection &face_detection,
+                         const FacePose &pose, bool has_mask,
                          FaceFeature &feature, QueryResult &person_info);
 
+  // Registered photos are unmasked, so masked faces score lower against them
+  static SZ_FLOAT masked_gallery_score(SZ_FLOAT score);
+
   // nyy
   const Size VPSS_CH_SIZES_BGR[3] = {
       {1920, 1080}, {1080, 704}, {320, 224}};  // larger small
@@ -49,7 +56,6 @@ class RecognizeTask : QObject {
   bool rx_nir_finished_;
   bool rx_bgr_finished_;
 
-  FaceDatabasePtr face_database_;
   FaceExtractorPtr face_extractor_;
   FaceAntiSpoofingPtr anti_spoofing_;
   MaskDetectorPtr mask_detector_;
@@ -12,6 +12,9 @@
 
 #include "audio_task.hpp"
 #include "config.hpp"
+#include "feature.hpp"
+#include "task_executor.hpp"
+#include "template_manager.hpp"
 
 #define CONTAIN_KEY(dict, key) ((dict).find((key)) != (dict).end())
 #define SECONDS_DIFF(t1, t2) \
@@ -43,18 +46,14 @@ RecordTask::RecordTask(QThread *thread, QObject *parent)
       latest_temperature_(0),
       has_unhandle_person_(false),
       has_card_no_(false),
+      card_cooldown_(false),
       is_enabled_(true) {
   person_service_ = PersonService::get_instance();
-  face_database_ = std::make_shared<FaceDatabase>(Config::get_quface().db_name);
 
-  // Create db for unknown faces
-  unknown_database_ = std::make_shared<FaceDatabase>("_UNKNOWN_DB_");
-
-  // Create thread
+  // Exclusive, get_person blocks on a request to the person service, which
+  // must not delay RecognizeTask
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_RECOGNIZE, true);
   } else {
     moveToThread(thread);
     thread->start();
@@ -62,15 +61,12 @@ RecordTask::RecordTask(QThread *thread, QObject *parent)
 }
 
 RecordTask::~RecordTask() {
-  if (unknown_database_) unknown_database_.reset();
-
-  person_history_.clear();
-  live_history_.clear();
+  voter_.clear();
   temperature_history_.clear();
 }
 
 void RecordTask::rx_frame(PingPangBuffer<RecognizeData> *buffer) {
-  if (is_running_) return;
+  if (is_running_ || card_cooldown_) return;
 
   is_running_ = true;
 
@@ -89,20 +85,19 @@ void RecordTask::rx_frame(PingPangBuffer<RecognizeData> *buffer) {
     }
 
     // add person info
-    mask_history_.push_back(input->has_mask);
-    person_history_.push_back(input->person_info);
+    voter_.add_person(input->person_info, input->has_mask);
 
     // do sequence mask detection
-    bgr_finished = sequence_mask(mask_history_, has_mask);
+    bgr_finished = sequence_mask(has_mask);
   }
 
   bool is_live = false;
   if (input->has_live) {
     // add antispoofing data
-    live_history_.push_back(input->is_live);
+    voter_.add_live(input->is_live);
 
     // do sequence antispoofing
-    ir_finished = sequence_antispoof(live_history_, is_live);
+    ir_finished = sequence_antispoof(is_live);
   }
 
   if (has_card_no_) {
@@ -112,26 +107,33 @@ void RecordTask::rx_frame(PingPangBuffer<RecognizeData> *buffer) {
     emit tx_display(person, false, false);
 
     rx_reset();
-    QThread::msleep(AudioTask::duration(person) * 1000);
 
-    has_card_no_ = false;
+    // Faces and cards are ignored until the result has been announced. The
+    // report is queued to the audio thread before this request, so the queue
+    // is not idle until the report has been played.
+    card_cooldown_ = true;
+    AudioTask::get_instance()->on_idle([this]() {
+      QMetaObject::invokeMethod(this, "rx_card_finished",
+                                Qt::QueuedConnection);
+    });
 
   } else if (is_enabled_ && bgr_finished && ir_finished) {
     if (is_live) {
       SZ_UINT32 face_id;
       PersonData person;
-      if (sequence_query(person_history_, mask_history_, has_mask, face_id,
-                         person.score)) {
+      if (sequence_query(has_mask, face_id, person.score)) {
+        // Learn the confirmed faces which are not matched well yet
+        auto templates = TemplateManager::get_instance();
         if (has_mask && person.score < 0.85)
-          face_database_->add(face_id, input->person_feature, 0.1);
+          templates->adapt(face_id, input->person_feature, has_mask);
         if (!has_mask && person.score < 0.9)
-          face_database_->add(face_id, input->person_feature, 0.1);
+          templates->adapt(face_id, input->person_feature, has_mask);
       }
       person.has_mask = has_mask;
 
       update_person_info(input, face_id, person);
 
-      auto cfg = Config::get_user();
+      auto &cfg = Config::get_user();
       if (duplicated_counter_ < cfg.duplication_limit) {
         int duration;
         bool duplicated =
@@ -164,41 +166,7 @@ void RecordTask::rx_frame(PingPangBuffer<RecognizeData> *buffer) {
 }
 
 bool RecordTask::if_fresh(const FaceFeature &feature) {
-  float score = 0.0;
-
-#if __ARM_NEON
-  assert(SZ_FEATURE_NUM % 16 == 0);
-  int dim = SZ_FEATURE_NUM;
-
-  const float *com_feat = feature.value;
-  const float *q_feat = latest_feature_.value;
-  float32x4_t out = vmovq_n_f32(0.0);
-  float32x4_t f1, f2;
-  float outTmp[4];
-  for (int k = 0; k < dim; k += 16) {
-    f1 = vld1q_f32(com_feat + k);
-    f2 = vld1q_f32(q_feat + k);
-    out = vmlaq_f32(out, f1, f2);
-
-    f1 = vld1q_f32(com_feat + k + 4);
-    f2 = vld1q_f32(q_feat + k + 4);
-    out = vmlaq_f32(out, f1, f2);
-
-    f1 = vld1q_f32(com_feat + k + 8);
-    f2 = vld1q_f32(q_feat + k + 8);
-    out = vmlaq_f32(out, f1, f2);
-
-    f1 = vld1q_f32(com_feat + k + 12);
-    f2 = vld1q_f32(q_feat + k + 12);
-    out = vmlaq_f32(out, f1, f2);
-  }
-  vst1q_f32(outTmp, out);
-
-  score = outTmp[0] + outTmp[1] + outTmp[2] + outTmp[3];
-#else
-  for (int k = 0; k < SZ_FEATURE_NUM; k++)
-    score += feature.value[k] * latest_feature_.value[k];
-#endif
+  float score = feature_dot(feature.value, latest_feature_.value);
 
   memcpy(latest_feature_.value, feature.value,
          SZ_FEATURE_NUM * sizeof(SZ_FLOAT));
@@ -207,9 +175,7 @@ bool RecordTask::if_fresh(const FaceFeature &feature) {
 }
 
 void RecordTask::reset_recognize() {
-  mask_history_.clear();
-  person_history_.clear();
-  live_history_.clear();
+  voter_.clear();
 
   emit tx_nir_finish(false);
   emit tx_bgr_finish(false);
@@ -220,45 +186,17 @@ void RecordTask::reset_temperature() {
   latest_temperature_ = 0;
 }
 
-bool RecordTask::sequence_query(const std::vector<QueryResult> &person_history,
-                                const std::vector<bool> &mask_history,
-                                const bool has_mask, SZ_UINT32 &face_id,
+bool RecordTask::sequence_query(const bool has_mask, SZ_UINT32 &face_id,
                                 SZ_FLOAT &score) {
-  // initialize map
-  std::map<SZ_UINT32, int> person_counts;
-  std::map<SZ_UINT32, float> person_accumulate_score;
-  std::map<SZ_UINT32, float> person_max_score;
-  for (auto &person : person_history) {
-    person_counts[person.face_id] = 0;
-    person_accumulate_score[person.face_id] = 0.f;
-    person_max_score[person.face_id] = 0.f;
-  }
-
-  // accumulate id and score
-  int max_count = 0;
+  int max_count;
   float accumulate_score;
-
-  auto pit = person_history.rbegin();
-  auto mit = mask_history.rbegin();
-  while (pit != person_history.rend() && mit != mask_history.rend()) {
-    if (*mit == has_mask) {
-      person_counts[pit->face_id] += 1;
-      person_accumulate_score[pit->face_id] += pit->score;
-      person_max_score[pit->face_id] =
-          std::max(pit->score, person_max_score[pit->face_id]);
-
-      if (person_counts[pit->face_id] > max_count) {
-        max_count = person_counts[pit->face_id];
-        face_id = pit->face_id;
-        score = person_max_score[face_id];
-        accumulate_score = person_accumulate_score[face_id];
-      }
-    }
-    pit++;
-    mit++;
+  if (!voter_.vote_person(has_mask, face_id, max_count, score,
+                          accumulate_score)) {
+    score = -1;
+    return false;
   }
 
-  auto cfg = Config::get_extract();
+  auto &cfg = Config::get_extract();
   SZ_LOG_DEBUG("count={}/{}, max={:.2f}/{:.2f}, sum={:.2f}/{:.2f}", max_count,
                cfg.history_size, score, cfg.min_recognize_score,
                accumulate_score, cfg.min_accumulate_score);
@@ -276,49 +214,13 @@ bool RecordTask::sequence_query(const std::vector<QueryResult> &person_history,
   return false;
 }
 
-bool RecordTask::sequence_antispoof(const std::vector<bool> &history,
-                                    bool &is_live) {
-  int min_count = Config::get_liveness().min_alive_count;
-  int max_count = Config::get_liveness().history_size;
-  if (history.size() < min_count) return false;
-
-  int live_count = 0, count = 0;
-  auto it = history.rbegin();
-  while (it != history.rend()) {
-    if (*it && ++live_count >= min_count) {
-      is_live = true;
-      return true;
-    }
-    if (++count >= max_count) {
-      is_live = false;
-      return true;
-    }
-    it++;
-  }
-
-  return false;
+bool RecordTask::sequence_antispoof(bool &is_live) {
+  auto &cfg = Config::get_liveness();
+  return voter_.vote_live(cfg.min_alive_count, cfg.history_size, is_live);
 }
 
-bool RecordTask::sequence_mask(const std::vector<bool> &history,
-                               bool &has_mask) {
-  int max_person = Config::get_extract().history_size;
-  if (history.size() < max_person) return false;
-
-  int mask = 0, no_mask = 0;
-  auto it = history.rbegin();
-  while (it != history.rend()) {
-    if (*it && ++mask >= max_person) {
-      has_mask = true;
-      return true;
-    }
-    if (!(*it) && ++no_mask >= max_person) {
-      has_mask = false;
-      return true;
-    }
-    it++;
-  }
-
-  return false;
+bool RecordTask::sequence_mask(bool &has_mask) {
+  return voter_.vote_mask(Config::get_extract().history_size, has_mask);
 }
 
 bool RecordTask::sequence_temperature(SZ_UINT32 face_id, int duration,
@@ -442,10 +344,6 @@ bool RecordTask::update_temperature_bias() {
     return true;
   }
 
-  if (count > 10) {
-    known_temperature_.clear();
-    unknown_temperature_.clear();
-  }
   return false;
 }
 
@@ -457,12 +355,22 @@ bool RecordTask::update_person_temperature(const SZ_UINT32 &face_id,
   temperature_history_.clear();
 
   if (person.temperature > 0 && Config::get_user().enable_temperature) {
-    if (person.status == PersonService::get_status(PersonStatus::Stranger))
+    if (person.status == PersonService::get_status(PersonStatus::Stranger)) {
+      // Only the strangers still in the gallery count for the bias, the
+      // others are never seen again
+      for (auto it = unknown_temperature_.begin();
+           it != unknown_temperature_.end();) {
+        if (stranger_gallery_.contains(it->first))
+          it++;
+        else
+          it = unknown_temperature_.erase(it);
+      }
       sequence_temperature(face_id, duration, unknown_temperature_,
                            person.temperature);
-    else
+    } else {
       sequence_temperature(face_id, duration, known_temperature_,
                            person.temperature);
+    }
     update_temperature_bias();
   }
 
@@ -568,9 +476,10 @@ void RecordTask::update_person_snapshot(RecognizeData *input,
     crop_w = std::min(width - crop_x - 1, crop_w * 2);
     crop_h = std::min(height - crop_y - 1, crop_h * 3 / 2);
 
-    cv::Mat(height, width, CV_8UC3,
-            snapshot->pData)({crop_x, crop_y, crop_w, crop_h})
-        .copyTo(person.face_snapshot);
+    // Converted to RGB once here, so the widgets can display it as it is
+    cv::cvtColor(cv::Mat(height, width, CV_8UC3,
+                         snapshot->pData)({crop_x, crop_y, crop_w, crop_h}),
+                 person.face_snapshot, CV_BGR2RGB);
   } else
     person.face_snapshot = cv::Mat();
 
@@ -584,7 +493,7 @@ bool RecordTask::if_duplicated(SZ_UINT32 &face_id, const FaceFeature &feature,
                                int &duration, PersonData &person) {
   bool ret = false;
 
-  auto cfg = Config::get_user();
+  auto &cfg = Config::get_user();
 
   auto current_query_clock = std::chrono::steady_clock::now();
 
@@ -603,19 +512,12 @@ bool RecordTask::if_duplicated(SZ_UINT32 &face_id, const FaceFeature &feature,
   }
   // query unknown person
   else {
-    SZ_UINT32 db_size;
-    unknown_database_->size(db_size);
-    face_id = 0;
-
-    if (db_size != 0) {
-      static std::vector<QueryResult> results;
-      results.clear();
-
-      SZ_RETCODE ret = unknown_database_->query(feature, 1, results);
-      if (SZ_RETCODE_OK == ret && results[0].score >= 0.8) {
-        face_id = results[0].face_id;
-        unknown_database_->add(face_id, feature);
-      }
+    float score;
+    face_id = stranger_gallery_.query(feature, 0.8, score);
+    if (face_id != 0) {
+      stranger_gallery_.update(face_id, feature);
+      SZ_LOG_DEBUG("stranger {} visits={}", face_id,
+                   stranger_gallery_.visits(face_id));
     }
 
     if (duplicated_counter_ != 0) {
@@ -627,9 +529,8 @@ bool RecordTask::if_duplicated(SZ_UINT32 &face_id, const FaceFeature &feature,
         ret = true;
 
     } else {
-      if (face_id == 0) face_id = (db_size % 100) + 1;
+      if (face_id == 0) face_id = stranger_gallery_.add(feature);
 
-      unknown_database_->add(face_id, feature);
       last_query_clock_ = current_query_clock;
     }
   }
@@ -672,6 +573,11 @@ void RecordTask::rx_card_readed(QString card_no) {
   }
 }
 
+void RecordTask::rx_card_finished() {
+  card_cooldown_ = false;
+  has_card_no_ = false;
+}
+
 void RecordTask::rx_enable(bool enable) {
   is_enabled_ = enable;
   rx_reset();
@@ -10,6 +10,8 @@
 #include "pingpang_buffer.hpp"
 #include "quface_common.hpp"
 #include "recognize_data.hpp"
+#include "sequence_voter.hpp"
+#include "stranger_gallery.hpp"
 
 namespace suanzi {
 
@@ -27,6 +29,7 @@ class RecordTask : QObject {
   void rx_temperature(float body_temperature);
 
   void rx_card_readed(QString card_no);
+  void rx_card_finished();
 
   void rx_reset();
 
@@ -48,11 +51,10 @@ class RecordTask : QObject {
   void reset_recognize();
   void reset_temperature();
 
-  bool sequence_query(const std::vector<QueryResult> &person_history,
-                      const std::vector<bool> &mask_history,
-                      const bool has_mask, SZ_UINT32 &face_id, SZ_FLOAT &score);
-  bool sequence_antispoof(const std::vector<bool> &history, bool &is_live);
-  bool sequence_mask(const std::vector<bool> &history, bool &has_mask);
+  bool sequence_query(const bool has_mask, SZ_UINT32 &face_id,
+                      SZ_FLOAT &score);
+  bool sequence_antispoof(bool &is_live);
+  bool sequence_mask(bool &has_mask);
   bool sequence_temperature(SZ_UINT32 face_id, int duration,
                             std::map<SZ_UINT32, float> &history,
                             float &temperature);
@@ -74,13 +76,11 @@ class RecordTask : QObject {
 
   PersonService::ptr person_service_;
 
-  FaceDatabasePtr face_database_, unknown_database_;
+  StrangerGallery stranger_gallery_;
 
-  std::vector<QueryResult> person_history_;
-  std::vector<bool> mask_history_;
+  SequenceVoter voter_;
   std::map<SZ_UINT32, float> known_temperature_;
 
-  std::vector<bool> live_history_;
   std::map<SZ_UINT32, float> unknown_temperature_;
 
   std::chrono::steady_clock::time_point last_query_clock_;
@@ -97,6 +97,7 @@ class RecordTask : QObject {
   float latest_temperature_;
 
   bool has_card_no_;
+  bool card_cooldown_;
   std::string card_no_;
 
   bool is_enabled_;
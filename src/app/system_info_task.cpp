@@ -0,0 +1,114 @@
+#include "system_info_task.hpp"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <quface/logger.hpp>
+
+#include "system.hpp"
+#include "task_executor.hpp"
+
+using namespace suanzi;
+
+constexpr int SystemInfoTask::REFRESH_DELAY_MS;
+constexpr int SystemInfoTask::POLL_INTERVAL_MS;
+
+bool SystemInfo::operator==(const SystemInfo &other) const {
+  return network == other.network && ip == other.ip && mac == other.mac &&
+         hostname == other.hostname && serial_number == other.serial_number;
+}
+
+SystemInfoTask *SystemInfoTask::get_instance() {
+  static SystemInfoTask instance;
+  return &instance;
+}
+
+SystemInfoTask::SystemInfoTask(QObject *parent)
+    : netlink_fd_(-1),
+      notifier_(nullptr),
+      refresh_timer_(nullptr),
+      poll_timer_(nullptr) {
+  qRegisterMetaType<SystemInfo>("SystemInfo");
+
+  // The first read is done here, so the widgets have the info from the start
+  System::get_current_network(info_.network, info_.ip, info_.mac);
+  System::get_hostname(info_.hostname);
+  System::get_serial_number(info_.serial_number);
+
+  TaskExecutor::get_instance()->attach(this, LANE_BACKGROUND);
+
+  // The notifier and timers must be created in the thread of the task
+  QMetaObject::invokeMethod(this, "rx_start", Qt::QueuedConnection);
+}
+
+SystemInfoTask::~SystemInfoTask() {
+  if (netlink_fd_ >= 0) close(netlink_fd_);
+}
+
+SystemInfo SystemInfoTask::get() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return info_;
+}
+
+int SystemInfoTask::open_netlink() {
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+  if (fd < 0) return -1;
+
+  struct sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void SystemInfoTask::rx_start() {
+  refresh_timer_ = new QTimer(this);
+  refresh_timer_->setSingleShot(true);
+  refresh_timer_->setInterval(REFRESH_DELAY_MS);
+  connect(refresh_timer_, SIGNAL(timeout()), this, SLOT(rx_refresh()));
+
+  poll_timer_ = new QTimer(this);
+  connect(poll_timer_, SIGNAL(timeout()), this, SLOT(rx_refresh()));
+  poll_timer_->start(POLL_INTERVAL_MS);
+
+  netlink_fd_ = open_netlink();
+  if (netlink_fd_ < 0) {
+    SZ_LOG_WARN("Open netlink socket failed, poll network every {}ms",
+                POLL_INTERVAL_MS);
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(netlink_fd_, QSocketNotifier::Read, this);
+  connect(notifier_, SIGNAL(activated(int)), this, SLOT(rx_netlink()));
+}
+
+void SystemInfoTask::rx_netlink() {
+  // Only the fact that something changed matters, drain the messages
+  char buf[4096];
+  while (recv(netlink_fd_, buf, sizeof(buf), 0) > 0) {
+  }
+
+  refresh_timer_->start();
+}
+
+void SystemInfoTask::rx_refresh() {
+  SystemInfo info;
+  System::get_current_network(info.network, info.ip, info.mac);
+  System::get_hostname(info.hostname);
+  System::get_serial_number(info.serial_number);
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (info == info_) return;
+    info_ = info;
+  }
+
+  SZ_LOG_INFO("Network changed to {} ip={}", info.network, info.ip);
+  emit tx_changed(info);
+}
@@ -0,0 +1,69 @@
+#ifndef SYSTEM_INFO_TASK_HPP
+#define SYSTEM_INFO_TASK_HPP
+
+#include <mutex>
+#include <string>
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTimer>
+
+namespace suanzi {
+
+struct SystemInfo {
+  std::string network;  // interface of the default route, "none" if offline
+  std::string ip;
+  std::string mac;  // without separators
+  std::string hostname;
+  std::string serial_number;
+
+  bool operator==(const SystemInfo &other) const;
+  bool operator!=(const SystemInfo &other) const { return !(*this == other); }
+};
+
+// Keeps the network and device information of the terminal up to date in
+// background. Link, address and route changes are watched on a netlink
+// socket, and the cached info is only read again after a change, so the
+// widgets never block on the system while painting.
+class SystemInfoTask : public QObject {
+  Q_OBJECT
+
+ public:
+  static SystemInfoTask *get_instance();
+
+  // Latest info, can be called from any thread
+  SystemInfo get();
+
+ signals:
+  void tx_changed(SystemInfo info);
+
+ private slots:
+  void rx_start();
+  void rx_netlink();
+  void rx_refresh();
+
+ private:
+  // Netlink events come in bursts, refresh once they are over
+  static constexpr int REFRESH_DELAY_MS = 200;
+  // The hostname has no event, and netlink may be unavailable
+  static constexpr int POLL_INTERVAL_MS = 30000;
+
+  SystemInfoTask(QObject *parent = nullptr);
+  ~SystemInfoTask();
+
+  int open_netlink();
+
+  std::mutex mutex_;
+  SystemInfo info_;
+
+  int netlink_fd_;
+  QSocketNotifier *notifier_;
+  QTimer *refresh_timer_;
+  QTimer *poll_timer_;
+};
+
+}  // namespace suanzi
+
+Q_DECLARE_METATYPE(suanzi::SystemInfo);
+
+#endif
@@ -0,0 +1,93 @@
+#include "task_executor.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <quface/logger.hpp>
+
+using namespace suanzi;
+
+typedef struct {
+  const char *name;
+  int cpu;
+  int nice;
+} LaneAttribute;
+
+// Capture and detection own the first core, the rest of the pipeline shares
+// the second core where background work runs with the lowest priority
+static const LaneAttribute LANE_ATTRIBUTES[LANE_COUNT] = {
+    {"capture", 0, -10}, {"detect", 0, -10}, {"recognize", 1, -5},
+    {"io", 1, 0},        {"background", 1, 10},
+};
+
+LaneThread::LaneThread(TaskLane lane, QObject *parent)
+    : QThread(parent), lane_(lane) {
+  setObjectName(LANE_ATTRIBUTES[lane].name);
+}
+
+void LaneThread::run() {
+  TaskExecutor::pin_current_thread(lane_);
+  exec();
+}
+
+TaskExecutor *TaskExecutor::get_instance() {
+  static TaskExecutor instance;
+  return &instance;
+}
+
+TaskExecutor::TaskExecutor() : threads_(LANE_COUNT, nullptr) {}
+
+TaskExecutor::~TaskExecutor() {
+  for (auto thread : exclusive_threads_) threads_.push_back(thread);
+  for (auto thread : threads_) {
+    if (thread == nullptr) continue;
+    thread->quit();
+    thread->wait();
+    delete thread;
+  }
+}
+
+void TaskExecutor::attach(QObject *task, TaskLane lane, bool exclusive) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Lane threads are started by their first task, so a lane without tasks
+  // costs nothing
+  if (!exclusive) {
+    if (threads_[lane] == nullptr) {
+      threads_[lane] = new LaneThread(lane);
+      threads_[lane]->start();
+    }
+    task->moveToThread(threads_[lane]);
+    return;
+  }
+
+  auto thread = new LaneThread(lane);
+  task->moveToThread(thread);
+  thread->start();
+  exclusive_threads_.push_back(thread);
+}
+
+void TaskExecutor::pin_current_thread(TaskLane lane) {
+  auto &attr = LANE_ATTRIBUTES[lane];
+
+  int cpu_count = std::thread::hardware_concurrency();
+  if (cpu_count > 0) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(attr.cpu % cpu_count, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      SZ_LOG_WARN("set {} thread affinity failed", attr.name);
+    }
+  }
+
+  // nice value is per thread on Linux
+  pid_t tid = syscall(SYS_gettid);
+  if (setpriority(PRIO_PROCESS, tid, attr.nice) != 0) {
+    SZ_LOG_WARN("set {} thread priority failed", attr.name);
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef TASK_EXECUTOR_H
+#define TASK_EXECUTOR_H
+
+#include <QObject>
+#include <QThread>
+#include <mutex>
+#include <vector>
+
+namespace suanzi {
+
+// Scheduling class of a task, from the most to the least latency sensitive
+typedef enum {
+  LANE_CAPTURE = 0,  // camera capture
+  LANE_DETECT,       // face detection
+  LANE_RECOGNIZE,    // feature extraction, liveness, database query
+  LANE_IO,           // audio, gpio, led, temperature
+  LANE_BACKGROUND,   // upload, http, enrollment
+  LANE_COUNT,
+} TaskLane;
+
+class LaneThread : public QThread {
+  Q_OBJECT
+
+ public:
+  LaneThread(TaskLane lane, QObject *parent = nullptr);
+
+ private:
+  void run() override;
+
+  TaskLane lane_;
+};
+
+// Shared worker threads for all tasks. Tasks are QObjects whose slots are
+// invoked by queued signals, so each one is attached to the worker thread of
+// its lane instead of owning a private thread. Lanes are pinned to a core and
+// have their own nice value, so that bursty background work cannot preempt
+// the recognition path.
+class TaskExecutor {
+ public:
+  static TaskExecutor *get_instance();
+
+  // Move the task to the worker thread of the lane, started on first use.
+  // Tasks which block in their slots (sleeps, device reads, network requests)
+  // must be exclusive, they get a thread of their own with the affinity and
+  // priority of the lane
+  void attach(QObject *task, TaskLane lane, bool exclusive = false);
+
+  // Apply the core affinity and priority of the lane to the calling thread,
+  // used by threads which are not driven by an event loop
+  static void pin_current_thread(TaskLane lane);
+
+ private:
+  TaskExecutor();
+  ~TaskExecutor();
+
+  std::mutex mutex_;
+  // Shared thread of each lane, nullptr until a task is attached to it
+  std::vector<LaneThread *> threads_;
+  std::vector<LaneThread *> exclusive_threads_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -1,58 +1,15 @@
 #include "temperature_task.hpp"
 
+#include <algorithm>
 #include <cmath>
-
-#include <quface-io/engine.hpp>
+#include <utility>
 
 #include "config.hpp"
-
-#define VALUE_AT(m, x, y) ((m.value)[(y)*16 + (x)])
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
 
-static float surface_to_inner(float temperature) {
-  if (temperature < 33) return temperature + 2.8;
-  if (temperature <= 33.1) return 35.8;
-  if (temperature <= 33.2) return 35.9;
-  if (temperature <= 33.5) return 36;
-  if (temperature <= 33.7) return 36.1;
-  if (temperature <= 34.1) return 36.2;
-  if (temperature <= 34.3) return 36.3;
-  if (temperature <= 34.4) return 36.4;
-  if (temperature <= 34.7) return 36.5;
-  if (temperature <= 34.8) return 36.6;
-  if (temperature <= 35.1) return 36.7;
-  if (temperature <= 35.5) return 36.8;
-  if (temperature <= 35.7) return 36.9;
-  if (temperature <= 36.1) return 37;
-  if (temperature <= 36.3) return 37.1;
-  if (temperature <= 36.4) return 37.2;
-  if (temperature <= 36.5) return 37.3;
-  if (temperature <= 36.6) return 37.5;
-  if (temperature <= 36.8)
-    return 37.6;
-  else
-    return temperature + 0.8;
-}
-
-static float measure_to_surface(float temperature) {
-  if (temperature <= 29.6) return temperature + 5.3;
-  if (temperature <= 29.7) return 35.1;
-  if (temperature <= 29.8) return 35.2;
-  if (temperature <= 30.3) return 35.5;
-  if (temperature <= 30.4) return 35.6;
-  if (temperature <= 30.9) return 35.7;
-  if (temperature <= 31.2) return 35.8;
-  if (temperature <= 31.3) return 36.1;
-  if (temperature <= 31.8) return temperature + 4.8;
-  if (temperature <= 31.9) return 36.7;
-  if (temperature <= 32)
-    return 36.9;
-  else
-    return temperature + 4.9;
-}
-
 TemperatureTask* TemperatureTask::get_instance() {
   static TemperatureTask instance(
       (io::TemperatureManufacturer)Config::get_temperature().manufacturer);
@@ -64,14 +21,23 @@ bool TemperatureTask::idle() { return !get_instance()->is_running_; }
 TemperatureTask::TemperatureTask(TemperatureManufacturer m, QThread* thread,
                                  QObject* parent)
     : m_(m),
-      temperature_reader_(nullptr),
       is_running_(false),
       ambient_temperature_(0),
-      face_temperature_(0) {
+      face_temperature_(0),
+      last_pts_(0),
+      has_pending_(false),
+      pending_frame_pts_(0),
+      pending_to_clear_(false),
+      pending_pts_(0),
+      mask_width_(0),
+      mask_height_(0) {
+  sampler_ = new ThermalSampler(m);
+  QObject::connect(sampler_, SIGNAL(tx_connecting(int)), this,
+                   SIGNAL(tx_heatmap_init(int)));
+
+  // The module is read by the sampler, so the slots never block
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_IO);
   } else {
     moveToThread(thread);
     thread->start();
@@ -80,108 +46,85 @@ TemperatureTask::TemperatureTask(TemperatureManufacturer m, QThread* thread,
 
 TemperatureTask::~TemperatureTask() {}
 
-void TemperatureTask::connect() {
-  static TemperatureMatrix mat;
-  int success = 0;
-  do {
-    while (temperature_reader_ == nullptr)
-      temperature_reader_ = Engine::instance()->get_temperature_reader(m_);
-    QThread::msleep(500);
-
-    if (try_reading(mat)) {
-      success++;
-      emit tx_heatmap_init(success);
-    } else {
-      temperature_reader_ = nullptr;
-      SZ_LOG_WARN("re-connecting for successive failure");
+void TemperatureTask::update_mask(int width, int height) {
+  // The area the sensor measures reliably, a circle in the middle
+  const float RADIUS = 6.f / 16.f;
+
+  mask_width_ = width;
+  mask_height_ = height;
+  mask_.resize(width * height);
+  for (int y = 0; y < height; y++) {
+    float dy = (float)y / height - 0.5f;
+    for (int x = 0; x < width; x++) {
+      float dx = (float)x / width - 0.5f;
+      mask_[y * width + x] = dx * dx + dy * dy <= RADIUS * RADIUS;
     }
-
-  } while (success < 10);
+  }
 }
 
-bool TemperatureTask::try_reading(TemperatureMatrix& mat) {
-  const int MAX_TRIAL = 10;
-  const int INTERVAL = 200;
-  int trial = 0;
-  while (SZ_RETCODE_OK != temperature_reader_->read(mat) && ++trial < MAX_TRIAL)
-    QThread::msleep(INTERVAL);
-
-  if (mat.size != 256) {
-    SZ_LOG_ERROR("only 16x16 is supported");
-    return false;
+void TemperatureTask::rx_update(DetectionRatio detection, bool to_clear,
+                                qint64 pts) {
+  // Each thermal frame is measured once, with the detection nearest to it, so
+  // the smoothing runs at the module rate. Detections come in pts order: one
+  // before the frame is held until the next shows whether it is the nearest.
+  int64_t frame_pts;
+  if (!sampler_->nearest(pts, frame_, frame_pts)) return;
+
+  if (has_pending_ && pending_frame_pts_ != frame_pts) {
+    // This detection is past the held frame, no later one is nearer to it
+    if (pts - pending_frame_pts_ < pending_frame_pts_ - pending_pts_)
+      measure(pending_frame_, pending_frame_pts_, detection, to_clear);
+    else
+      measure(pending_frame_, pending_frame_pts_, pending_detection_,
+              pending_to_clear_);
+    has_pending_ = false;
   }
-
-  bool ret = trial < MAX_TRIAL;
-  if (ret) {
-    QThread::msleep(INTERVAL);
-    auto cfg = Config::get_temperature();
-    switch (cfg.sensor_rotation) {
-      case TemperatureRotation::ROTATION_90:
-        for (int y = 0; y < 16 / 2; y++) {
-          for (int x = y; x < 16 - y - 1; x++) {
-            float t = VALUE_AT(mat, x, y);
-            VALUE_AT(mat, x, y) = VALUE_AT(mat, y, 16 - x - 1);
-            VALUE_AT(mat, y, 16 - x - 1) =
-                VALUE_AT(mat, 16 - x - 1, 16 - y - 1);
-            VALUE_AT(mat, 16 - x - 1, 16 - y - 1) =
-                VALUE_AT(mat, 16 - y - 1, x);
-            VALUE_AT(mat, 16 - y - 1, x) = t;
-          }
-        }
-        break;
-      case TemperatureRotation::ROTATION_180:
-        for (int y = 0; y < 16 / 2; y++) {
-          for (int x = 0; x < 16; x++) {
-            float t = VALUE_AT(mat, x, y);
-            VALUE_AT(mat, x, y) = VALUE_AT(mat, 16 - x - 1, 16 - y - 1);
-            VALUE_AT(mat, 16 - x - 1, 16 - y - 1) = t;
-          }
-        }
-        break;
-      case TemperatureRotation::ROTATION_270:
-        for (int y = 0; y < 16 / 2; y++) {
-          for (int x = y; x < 16 - y - 1; x++) {
-            float t = VALUE_AT(mat, x, y);
-            VALUE_AT(mat, x, y) = VALUE_AT(mat, 16 - y - 1, x);
-            VALUE_AT(mat, 16 - y - 1, x) =
-                VALUE_AT(mat, 16 - x - 1, 16 - y - 1);
-            VALUE_AT(mat, 16 - x - 1, 16 - y - 1) =
-                VALUE_AT(mat, y, 16 - x - 1);
-            VALUE_AT(mat, y, 16 - x - 1) = t;
-          }
-        }
-        break;
-      default:
-        break;
-    }
+  if (frame_pts == last_pts_) return;
+
+  if (pts < frame_pts) {
+    has_pending_ = true;
+    std::swap(pending_frame_, frame_);
+    pending_frame_pts_ = frame_pts;
+    pending_detection_ = detection;
+    pending_to_clear_ = to_clear;
+    pending_pts_ = pts;
+    return;
   }
 
-  return ret;
+  if (has_pending_ && frame_pts - pending_pts_ < pts - frame_pts)
+    measure(frame_, frame_pts, pending_detection_, pending_to_clear_);
+  else
+    measure(frame_, frame_pts, detection, to_clear);
+  has_pending_ = false;
 }
 
-void TemperatureTask::rx_update(DetectionRatio detection, bool to_clear) {
-  is_running_ = true;
+void TemperatureTask::measure(const ThermalFrame& frame, int64_t frame_pts,
+                              DetectionRatio detection, bool to_clear) {
+  last_pts_ = frame_pts;
 
-  if (ambient_temperature_ == 0) connect();
+  is_running_ = true;
 
-  static TemperatureMatrix mat;
-  while (!try_reading(mat)) QThread::msleep(1);
+  if (frame.width != mask_width_ || frame.height != mask_height_)
+    update_mask(frame.width, frame.height);
 
-  auto cfg = Config::get_temperature();
+  auto &cfg = Config::get_temperature();
+  const int width = frame.width, height = frame.height;
 
   if (!to_clear) {
     float x1 = (cfg.max_x - cfg.min_x) * detection.x + cfg.min_x;
     float x2 =
         (cfg.max_x - cfg.min_x) * (detection.x + detection.width) + cfg.min_x;
-    detection.x = std::max(floor(x1 * 16) - 1, 0.f) / 16.f;
-    detection.width = std::min(ceil(x2 * 16) + 1, 16.f) / 16.f - detection.x;
+    detection.x = std::max(floor(x1 * width) - 1, 0.f) / width;
+    detection.width =
+        std::min(ceil(x2 * width) + 1, (float)width) / width - detection.x;
 
     float y1 = (cfg.max_y - cfg.min_y) * detection.y + cfg.min_y;
     float y2 =
         (cfg.max_y - cfg.min_y) * (detection.y + detection.height) + cfg.min_y;
 
-    detection.y = std::max(floor((y1 - (y2 - y1) * .2f) * 16), 0.f) / 16.f;
-    detection.height = std::max((y2 - y1) * .4f * 16, 2.f) / 16.f;
+    detection.y =
+        std::max(floor((y1 - (y2 - y1) * .2f) * height), 0.f) / height;
+    detection.height = std::max((y2 - y1) * .4f * height, 2.f) / height;
   } else {
     detection.x = 0.45;
     detection.y = 0.45;
@@ -189,23 +132,13 @@ void TemperatureTask::rx_update(DetectionRatio detection, bool to_clear) {
     detection.height = 0.1;
   }
 
-  float max_x, max_y;
-  float max_temperature = 0;
-  static std::vector<float> statistics;
-  statistics.clear();
-  for (size_t i = 0; i < 256; i++) {
-    float x = (i % 16) / 16.f, y = (i / 16) / 16.f;
-    if (pow(x - 0.5f, 2) + pow(y - 0.5f, 2) <= pow(6.f / 16.f, 2) &&
-        detection.x <= x && x <= detection.x + detection.width &&
-        detection.y <= y && y <= detection.y + detection.height) {
-      statistics.push_back(mat.value[i]);
-      if (mat.value[i] > max_temperature) {
-        max_temperature = mat.value[i];
-        max_x = x;
-        max_y = y;
-      }
-    }
-  }
+  // Maximum, mean and variance of the face in one pass
+  auto stats = frame.measure(mask_, detection.x, detection.y, detection.width,
+                             detection.height);
+  float max_x = stats.max_x, max_y = stats.max_y;
+  float max_temperature = stats.max_temperature;
+  int count = stats.count;
+  double sum = stats.sum, sum_squares = stats.sum_squares;
 
   static float current_var = -1;
   if (to_clear) {
@@ -219,11 +152,12 @@ void TemperatureTask::rx_update(DetectionRatio detection, bool to_clear) {
     face_temperature_ = 0;
     current_var = -1;
   } else {
-    float avg = 0, var = 0;
-    for (float v : statistics) avg += v / statistics.size();
-    for (float v : statistics) var += (v - avg) * (v - avg);
-    face_temperature_ = surface_to_inner(
-        measure_to_surface(max_temperature + Config::get_temperature_bias()));
+    // Sum of squared deviations from the mean
+    float var = count > 0 ? std::max(sum_squares - sum * sum / count, 0.) : 0;
+    auto &calibration = Config::get_temperature_calibration();
+    face_temperature_ = calibration.surface_to_inner.map(
+        calibration.measure_to_surface.map(max_temperature +
+                                           Config::get_temperature_bias()));
 
     if (current_var < 0)
       current_var = var;
@@ -245,15 +179,7 @@ void TemperatureTask::rx_update(DetectionRatio detection, bool to_clear) {
     }
   }
 
-  static TemperatureMatrix output;
-  if (output.value == nullptr)
-    output.value = (float*)malloc(256 * sizeof(float));
-  if (output.size != 256)
-    output.value = (float*)realloc(output.value, 256 * sizeof(float));
-  output.size = 256;
-  memcpy(output.value, mat.value, output.size * sizeof(float));
-
-  emit tx_heatmap(output, detection, max_x, max_y);
+  emit tx_heatmap(frame, detection, max_x, max_y);
 
   is_running_ = false;
 }
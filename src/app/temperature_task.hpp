@@ -1,6 +1,8 @@
 #ifndef __TEMPERATURE_TASK_HPP__
 #define __TEMPERATURE_TASK_HPP__
 
+#include <vector>
+
 #include <QThread>
 #include <QTimer>
 
@@ -8,6 +10,8 @@
 #include <quface-io/temperature.hpp>
 
 #include "detection_data.hpp"
+#include "thermal_frame.hpp"
+#include "thermal_sampler.hpp"
 
 namespace suanzi {
 using namespace io;
@@ -22,11 +26,12 @@ class TemperatureTask : public QObject {
  signals:
   void tx_temperature(float temperature);
   void tx_heatmap_init(int success);
-  void tx_heatmap(TemperatureMatrix mat, DetectionRatio detection, float x,
+  void tx_heatmap(ThermalFrame frame, DetectionRatio detection, float x,
                   float y);
 
  private slots:
-  void rx_update(DetectionRatio detection, bool to_clear);
+  // pts is the capture time of the image the face was detected in
+  void rx_update(DetectionRatio detection, bool to_clear, qint64 pts);
 
  private:
   static constexpr float DEFAULT_OFFSET = 6;
@@ -36,16 +41,36 @@ class TemperatureTask : public QObject {
   ~TemperatureTask();
 
  private:
-  void connect();
-  bool try_reading(TemperatureMatrix& mat);
+  void update_mask(int width, int height);
 
   TemperatureManufacturer m_;
-  TemperatureReader::ptr temperature_reader_;
+  ThermalSampler* sampler_;
 
   bool is_running_;
 
   float ambient_temperature_;
   float face_temperature_;
+
+  // Measures one thermal frame against the face in detection
+  void measure(const ThermalFrame& frame, int64_t frame_pts,
+               DetectionRatio detection, bool to_clear);
+
+  // The thermal frame nearest to the last detection
+  ThermalFrame frame_;
+  // Capture time of the last measured thermal frame
+  int64_t last_pts_;
+  // A detection before pending_frame_, held until it is known to be the
+  // nearest to it
+  bool has_pending_;
+  ThermalFrame pending_frame_;
+  int64_t pending_frame_pts_;
+  DetectionRatio pending_detection_;
+  bool pending_to_clear_;
+  int64_t pending_pts_;
+  // Cells inside the measuring circle, for the last measured geometry
+  std::vector<uint8_t> mask_;
+  int mask_width_;
+  int mask_height_;
 };
 
 }  // namespace suanzi
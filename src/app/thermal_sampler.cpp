@@ -0,0 +1,106 @@
+#include "thermal_sampler.hpp"
+
+#include <cstdlib>
+
+#include <quface-io/engine.hpp>
+#include <quface/logger.hpp>
+
+#include "camera_capturer.hpp"
+#include "task_executor.hpp"
+
+using namespace suanzi;
+using namespace suanzi::io;
+
+constexpr int ThermalSampler::FRAME_INTERVAL_MS;
+constexpr int ThermalSampler::RECONNECT_INTERVAL_MS;
+constexpr int ThermalSampler::MAX_FAILURES;
+constexpr int ThermalSampler::CONNECTED_READINGS;
+constexpr size_t ThermalSampler::CAPACITY;
+constexpr int64_t ThermalSampler::MAX_PTS_DIFF_US;
+
+ThermalSampler::ThermalSampler(TemperatureManufacturer m, QObject *parent)
+    : m_(m), reader_(nullptr), samples_(CAPACITY), head_(0), count_(0) {
+  start();
+}
+
+ThermalSampler::~ThermalSampler() {}
+
+bool ThermalSampler::nearest(int64_t pts, ThermalFrame &frame,
+                             int64_t &frame_pts) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  const Sample *best = nullptr;
+  for (size_t i = 0; i < count_; i++) {
+    const Sample &sample = samples_[i];
+    if (best == nullptr ||
+        std::llabs(sample.pts - pts) < std::llabs(best->pts - pts))
+      best = &sample;
+  }
+
+  if (best == nullptr || std::llabs(best->pts - pts) > MAX_PTS_DIFF_US)
+    return false;
+
+  frame = best->frame;
+  frame_pts = best->pts;
+  return true;
+}
+
+bool ThermalSampler::read(TemperatureMatrix &mat) {
+  if (SZ_RETCODE_OK != reader_->read(mat)) return false;
+
+  auto &cfg = Config::get_temperature();
+  if (mat.size != cfg.sensor_width * cfg.sensor_height) {
+    SZ_LOG_ERROR("Read {} temperatures, but the sensor is {}x{}", mat.size,
+                 cfg.sensor_width, cfg.sensor_height);
+    return false;
+  }
+  return true;
+}
+
+void ThermalSampler::push(const TemperatureMatrix &mat, int64_t pts) {
+  auto &cfg = Config::get_temperature();
+
+  // Rotated outside the lock, which only covers the swap into the ring
+  ThermalFrame frame;
+  frame.assign_rotated(mat.value, cfg.sensor_width, cfg.sensor_height,
+                       cfg.sensor_rotation);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  samples_[head_].pts = pts;
+  samples_[head_].frame.values.swap(frame.values);
+  samples_[head_].frame.width = frame.width;
+  samples_[head_].frame.height = frame.height;
+  head_ = (head_ + 1) % CAPACITY;
+  if (count_ < CAPACITY) count_++;
+}
+
+void ThermalSampler::run() {
+  TaskExecutor::pin_current_thread(LANE_IO);
+
+  TemperatureMatrix mat;
+  int success = 0;
+  int failures = 0;
+  while (true) {
+    if (reader_ == nullptr) {
+      reader_ = Engine::instance()->get_temperature_reader(m_);
+      QThread::msleep(RECONNECT_INTERVAL_MS);
+      success = failures = 0;
+      continue;
+    }
+
+    // The module reads out its last frame, stamp it with the middle of the
+    // transfer rather than its end
+    int64_t start = CameraCapturer::now_us();
+    if (read(mat)) {
+      push(mat, (start + CameraCapturer::now_us()) / 2);
+      failures = 0;
+      if (success < CONNECTED_READINGS) emit tx_connecting(++success);
+    } else if (++failures >= MAX_FAILURES) {
+      SZ_LOG_WARN("re-connecting for successive failure");
+      reader_ = nullptr;
+      continue;
+    }
+
+    QThread::msleep(FRAME_INTERVAL_MS);
+  }
+}
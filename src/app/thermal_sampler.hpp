@@ -0,0 +1,65 @@
+#ifndef THERMAL_SAMPLER_H
+#define THERMAL_SAMPLER_H
+
+#include <QThread>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <quface-io/temperature.hpp>
+
+#include "config.hpp"
+#include "thermal_frame.hpp"
+
+namespace suanzi {
+
+// Reads the temperature module on its own thread at the module frame rate,
+// and keeps the latest frames with their capture time, on the same clock as
+// the camera pts. Consumers pick the frame closest to the capture time of an
+// image instead of blocking on the module.
+class ThermalSampler : public QThread {
+  Q_OBJECT
+
+ public:
+  ThermalSampler(io::TemperatureManufacturer m, QObject *parent = nullptr);
+  ~ThermalSampler();
+
+  // The frame captured closest to pts, false if none is within
+  // MAX_PTS_DIFF_US
+  bool nearest(int64_t pts, ThermalFrame &frame, int64_t &frame_pts);
+
+ signals:
+  // Successive good readings after (re)connecting, up to CONNECTED_READINGS
+  void tx_connecting(int success);
+
+ private:
+  void run() override;
+  bool read(io::TemperatureMatrix &mat);
+  void push(const io::TemperatureMatrix &mat, int64_t pts);
+
+  // The modules refresh at about 5fps, reading faster returns the same frame
+  static constexpr int FRAME_INTERVAL_MS = 200;
+  static constexpr int RECONNECT_INTERVAL_MS = 500;
+  static constexpr int MAX_FAILURES = 10;
+  static constexpr int CONNECTED_READINGS = 10;
+  static constexpr size_t CAPACITY = 8;
+  static constexpr int64_t MAX_PTS_DIFF_US = 1000000;
+
+  io::TemperatureManufacturer m_;
+  io::TemperatureReader::ptr reader_;
+
+  struct Sample {
+    int64_t pts;
+    ThermalFrame frame;
+  };
+
+  std::mutex mutex_;
+  // Ring buffer, head_ is the next slot to write
+  std::vector<Sample> samples_;
+  size_t head_;
+  size_t count_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -5,6 +5,7 @@
 #include <quface-io/engine.hpp>
 
 #include "config.hpp"
+#include "task_executor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -19,9 +20,7 @@ UploadTask::UploadTask(QThread *thread, QObject *parent) {
 
   // Create thread
   if (thread == nullptr) {
-    static QThread new_thread;
-    moveToThread(&new_thread);
-    new_thread.start();
+    TaskExecutor::get_instance()->attach(this, LANE_BACKGROUND);
   } else {
     moveToThread(thread);
     thread->start();
@@ -35,7 +34,7 @@ void UploadTask::rx_upload(PersonData person, bool audio_duplicated,
   static std::vector<SZ_UINT8> bgr_image_buffer;
   static std::vector<SZ_UINT8> nir_image_buffer;
 
-  auto cfg = Config::get_user();
+  auto &cfg = Config::get_user();
   if (!record_duplicated) {
     // whether is known person
     if ((person.status == PersonService::get_status(PersonStatus::Normal) ||
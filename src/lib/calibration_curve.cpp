@@ -0,0 +1,131 @@
+#include "calibration_curve.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace suanzi;
+
+CalibrationCurve::CalibrationCurve(std::vector<Point> points)
+    : points_(std::move(points)) {
+  std::sort(points_.begin(), points_.end());
+}
+
+float CalibrationCurve::map(float x) const {
+  if (points_.empty()) return x;
+
+  auto &first = points_.front();
+  auto &last = points_.back();
+  if (x <= first.first) return x + first.second - first.first;
+  if (x >= last.first) return x + last.second - last.first;
+
+  // First point after x, both it and the previous one exist here
+  auto it = std::upper_bound(
+      points_.begin(), points_.end(), x,
+      [](float v, const Point &p) { return v < p.first; });
+  auto &p1 = *it;
+  auto &p0 = *(it - 1);
+  if (p1.first == p0.first) return p1.second;
+  return p0.second +
+         (x - p0.first) * (p1.second - p0.second) / (p1.first - p0.first);
+}
+
+// The step tables compared float readings with double bounds, a step over
+// (lower, upper] starts at the first float above lower and ends at the last
+// float up to upper. No float lies between the end of one step and the start
+// of the next, so a pair of points per step reproduces the jumps exactly.
+static float float_above(double v) {
+  float f = v;
+  return f > v ? f : std::nextafter(f, INFINITY);
+}
+
+static float float_upto(double v) {
+  float f = v;
+  return f <= v ? f : std::nextafter(f, -INFINITY);
+}
+
+static CalibrationCurve::Point shifted(float x, double offset) {
+  return CalibrationCurve::Point(x, x + offset);
+}
+
+// value over (lower, upper]
+static void add_step(std::vector<CalibrationCurve::Point> &points,
+                     double lower, double upper, float value) {
+  points.emplace_back(float_above(lower), value);
+  points.emplace_back(float_upto(upper), value);
+}
+
+// x + offset over (lower, upper]
+static void add_shift(std::vector<CalibrationCurve::Point> &points,
+                      double lower, double upper, double offset) {
+  points.push_back(shifted(float_above(lower), offset));
+  points.push_back(shifted(float_upto(upper), offset));
+}
+
+TemperatureCalibration suanzi::default_temperature_calibration() {
+  std::vector<CalibrationCurve::Point> measure;
+  measure.push_back(shifted(float_upto(29.6), 5.3));
+  add_step(measure, 29.6, 29.7, 35.1);
+  add_step(measure, 29.7, 29.8, 35.2);
+  add_step(measure, 29.8, 30.3, 35.5);
+  add_step(measure, 30.3, 30.4, 35.6);
+  add_step(measure, 30.4, 30.9, 35.7);
+  add_step(measure, 30.9, 31.2, 35.8);
+  add_step(measure, 31.2, 31.3, 36.1);
+  add_shift(measure, 31.3, 31.8, 4.8);
+  add_step(measure, 31.8, 31.9, 36.7);
+  add_step(measure, 31.9, 32, 36.9);
+  measure.push_back(shifted(float_above(32), 4.9));
+
+  // The first step includes 33, so it starts right after the float below it
+  std::vector<CalibrationCurve::Point> inner;
+  float below = std::nextafter(33.f, 0.f);
+  inner.push_back(shifted(below, 2.8));
+  add_step(inner, below, 33.1, 35.8);
+  add_step(inner, 33.1, 33.2, 35.9);
+  add_step(inner, 33.2, 33.5, 36);
+  add_step(inner, 33.5, 33.7, 36.1);
+  add_step(inner, 33.7, 34.1, 36.2);
+  add_step(inner, 34.1, 34.3, 36.3);
+  add_step(inner, 34.3, 34.4, 36.4);
+  add_step(inner, 34.4, 34.7, 36.5);
+  add_step(inner, 34.7, 34.8, 36.6);
+  add_step(inner, 34.8, 35.1, 36.7);
+  add_step(inner, 35.1, 35.5, 36.8);
+  add_step(inner, 35.5, 35.7, 36.9);
+  add_step(inner, 35.7, 36.1, 37);
+  add_step(inner, 36.1, 36.3, 37.1);
+  add_step(inner, 36.3, 36.4, 37.2);
+  add_step(inner, 36.4, 36.5, 37.3);
+  add_step(inner, 36.5, 36.6, 37.5);
+  add_step(inner, 36.6, 36.8, 37.6);
+  inner.push_back(shifted(float_above(36.8), 0.8));
+
+  TemperatureCalibration c;
+  c.measure_to_surface = CalibrationCurve(std::move(measure));
+  c.surface_to_inner = CalibrationCurve(std::move(inner));
+  return c;
+}
+
+void suanzi::to_json(json &j, const CalibrationCurve &c) {
+  j = json::array();
+  for (auto &p : c.points()) j.push_back({p.first, p.second});
+}
+
+void suanzi::from_json(const json &j, CalibrationCurve &c) {
+  std::vector<CalibrationCurve::Point> points;
+  for (auto &p : j)
+    points.emplace_back(p.at(0).get<float>(), p.at(1).get<float>());
+  c = CalibrationCurve(std::move(points));
+}
+
+void suanzi::to_json(json &j, const TemperatureCalibration &c) {
+  j["measure_to_surface"] = c.measure_to_surface;
+  j["surface_to_inner"] = c.surface_to_inner;
+}
+
+void suanzi::from_json(const json &j, TemperatureCalibration &c) {
+  if (j.contains("measure_to_surface"))
+    j.at("measure_to_surface").get_to(c.measure_to_surface);
+  if (j.contains("surface_to_inner"))
+    j.at("surface_to_inner").get_to(c.surface_to_inner);
+}
@@ -0,0 +1,50 @@
+#ifndef CALIBRATION_CURVE_H
+#define CALIBRATION_CURVE_H
+
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace suanzi {
+
+using json = nlohmann::json;
+
+// Piecewise-linear mapping given by points sorted by input. Between points
+// the output is interpolated, beyond the first or last point the offset of
+// that point is kept. A curve without points is the identity.
+class CalibrationCurve {
+ public:
+  typedef std::pair<float, float> Point;
+
+  CalibrationCurve() {}
+  CalibrationCurve(std::vector<Point> points);
+
+  float map(float x) const;
+
+  const std::vector<Point> &points() const { return points_; }
+
+ private:
+  std::vector<Point> points_;
+};
+
+void to_json(json &j, const CalibrationCurve &c);
+void from_json(const json &j, CalibrationCurve &c);
+
+// Converts a sensor reading to the body temperature in two steps, fitted
+// separately against a surface and a body thermometer
+typedef struct {
+  CalibrationCurve measure_to_surface;
+  CalibrationCurve surface_to_inner;
+} TemperatureCalibration;
+
+void to_json(json &j, const TemperatureCalibration &c);
+void from_json(const json &j, TemperatureCalibration &c);
+
+// The step tables TemperatureTask used before the curves were configurable,
+// two points per step so they map every reading as the tables did
+TemperatureCalibration default_temperature_calibration();
+
+}  // namespace suanzi
+
+#endif
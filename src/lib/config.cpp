@@ -1,7 +1,13 @@
 #include "config.hpp"
 
 #include <QFile>
+#include <cstdio>
 #include <regex>
+#include <thread>
+
+#include <unistd.h>
+
+#include "sequence_voter.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -121,10 +127,13 @@ void suanzi::to_json(json &j, const TemperatureConfig &c) {
   SAVE_JSON_TO(j, "manufacturer", c.manufacturer);
   SAVE_JSON_TO(j, "temperature_delay", c.temperature_delay);
   SAVE_JSON_TO(j, "sensor_rotation", c.sensor_rotation);
+  SAVE_JSON_TO(j, "sensor_width", c.sensor_width);
+  SAVE_JSON_TO(j, "sensor_height", c.sensor_height);
   SAVE_JSON_TO(j, "min_x", c.min_x);
   SAVE_JSON_TO(j, "max_x", c.max_x);
   SAVE_JSON_TO(j, "min_y", c.min_y);
   SAVE_JSON_TO(j, "max_y", c.max_y);
+  SAVE_JSON_TO(j, "calibrations", c.calibrations);
 }
 
 void suanzi::from_json(const json &j, TemperatureConfig &c) {
@@ -136,10 +145,13 @@ void suanzi::from_json(const json &j, TemperatureConfig &c) {
   LOAD_JSON_TO(j, "manufacturer", c.manufacturer);
   LOAD_JSON_TO(j, "temperature_delay", c.temperature_delay);
   LOAD_JSON_TO(j, "sensor_rotation", c.sensor_rotation);
+  LOAD_JSON_TO(j, "sensor_width", c.sensor_width);
+  LOAD_JSON_TO(j, "sensor_height", c.sensor_height);
   LOAD_JSON_TO(j, "min_x", c.min_x);
   LOAD_JSON_TO(j, "max_x", c.max_x);
   LOAD_JSON_TO(j, "min_y", c.min_y);
   LOAD_JSON_TO(j, "max_y", c.max_y);
+  LOAD_JSON_TO(j, "calibrations", c.calibrations);
 }
 
 void suanzi::to_json(json &j, const QufaceConfig &c) {
@@ -208,12 +220,29 @@ void suanzi::to_json(json &j, const ExtractConfig &c) {
   SAVE_JSON_TO(j, "max_lost_age", c.max_lost_age);
 }
 
+// The histories are voted on by SequenceVoter, which keeps CAPACITY frames. A
+// larger count could never be reached and the vote would never be decided.
+static void clamp_history_count(const char *name, SZ_INT32 &value) {
+  const SZ_INT32 max_value = SequenceVoter::CAPACITY;
+  if (value > max_value) {
+    SZ_LOG_WARN("{}={} exceeds the history capacity, use {}", name, value,
+                max_value);
+    value = max_value;
+  } else if (value < 1) {
+    SZ_LOG_WARN("{}={} is invalid, use 1", name, value);
+    value = 1;
+  }
+}
+
 void suanzi::from_json(const json &j, ExtractConfig &c) {
   LOAD_JSON_TO(j, "history_size", c.history_size);
   LOAD_JSON_TO(j, "min_recognize_count", c.min_recognize_count);
   LOAD_JSON_TO(j, "min_recognize_score", c.min_recognize_score);
   LOAD_JSON_TO(j, "min_accumulate_score", c.min_accumulate_score);
   LOAD_JSON_TO(j, "max_lost_age", c.max_lost_age);
+
+  clamp_history_count("history_size", c.history_size);
+  clamp_history_count("min_recognize_count", c.min_recognize_count);
 }
 
 void suanzi::to_json(json &j, const LivenessConfig &c) {
@@ -240,6 +269,9 @@ void suanzi::from_json(const json &j, LivenessConfig &c) {
                c.min_height_ratio_between_bgr);
   LOAD_JSON_TO(j, "max_height_ratio_between_bgr",
                c.max_height_ratio_between_bgr);
+
+  clamp_history_count("history_size", c.history_size);
+  clamp_history_count("min_alive_count", c.min_alive_count);
 }
 
 void suanzi::from_json(const json &j, ConfigData &c) {
@@ -278,11 +310,55 @@ void suanzi::to_json(json &j, const ConfigData &c) {
   SAVE_JSON_TO(j, "pro", pro);
 }
 
+ConfigSnapshot::ConfigSnapshot(const ConfigData &data)
+    : data(data),
+      detect(this->data.detect_levels_.get(this->data.user.detect_level)),
+      extract(this->data.extract_levels_.get(this->data.user.extract_level)),
+      liveness(
+          this->data.liveness_levels_.get(this->data.user.liveness_level)) {}
+
+constexpr int Config::RETIRE_DELAY_S;
+
 Config Config::instance_;
 
 Config *Config::get_instance() { return &instance_; }
 
-void Config::to_json(json &j) { ::to_json(j, instance_.cfg_data_); }
+Config::Config()
+    : temperature_finetune_(0),
+      write_pending_(false),
+      writing_(false) {
+  ConfigData data = ConfigData();
+  load_defaults(data);
+  publish(data);
+}
+
+const std::vector<std::pair<ConfigSection, std::string>>
+    Config::SECTION_NAMES = {
+        {SECTION_USER, "user"},
+        {SECTION_APP, "app"},
+        {SECTION_TEMPERATURE, "temperature"},
+        {SECTION_QUFACE, "quface"},
+        {SECTION_CAMERAS, "cameras"},
+        {SECTION_PRO, "pro"},
+};
+
+Config::~Config() { flush_override_config(); }
+
+void Config::to_json(json &j) { j = instance_.current_json(); }
+
+void Config::publish(const ConfigData &data) {
+  auto snapshot = std::make_shared<const ConfigSnapshot>(data);
+  temperature_finetune_.store(data.user.temperature_finetune);
+  auto prev = std::atomic_exchange(&snapshot_, snapshot);
+
+  // Freed once no reader can still hold a reference from the getters
+  auto now = std::chrono::steady_clock::now();
+  if (prev) retired_.emplace_back(now, std::move(prev));
+  while (!retired_.empty() &&
+         now - retired_.front().first >
+             std::chrono::seconds(RETIRE_DELAY_S))
+    retired_.pop_front();
+}
 
 void Config::load_defaults(ConfigData &c) {
   c.app = {
@@ -308,10 +384,16 @@ void Config::load_defaults(ConfigData &c) {
       .temperature_delay = 5,
       .manufacturer = -1,
       .sensor_rotation = TemperatureRotation::None,
+      .sensor_width = 16,
+      .sensor_height = 16,
       .min_x = 0.3125,
       .max_x = 0.875,
       .min_y = 0,
       .max_y = 1,
+      .calibrations =
+          {
+              {"default", default_temperature_calibration()},
+          },
   };
 
   c.user = {
@@ -486,6 +568,30 @@ SZ_RETCODE Config::load_from_file(const std::string &config_file,
   return reload();
 }
 
+bool Config::write_file_atomic(const std::string &filename,
+                               const std::string &content) {
+  // Write to a temporary file and rename, so a power loss never leaves a
+  // truncated config behind
+  std::string tmp_filename = filename + ".tmp";
+  FILE *fp = fopen(tmp_filename.c_str(), "w");
+  if (fp == nullptr) {
+    SZ_LOG_ERROR("Open {} for write failed", tmp_filename);
+    return false;
+  }
+
+  bool ok = fwrite(content.data(), 1, content.size(), fp) == content.size();
+  ok = fflush(fp) == 0 && ok;
+  ok = fsync(fileno(fp)) == 0 && ok;
+  fclose(fp);
+
+  if (!ok || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    SZ_LOG_ERROR("Write {} failed", filename);
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
 SZ_RETCODE Config::read_config(json &cfg) {
   ConfigData cfg_data;
   load_defaults(cfg_data);
@@ -501,12 +607,9 @@ SZ_RETCODE Config::read_config(json &cfg) {
     config.merge_patch(file_cfg);
   }
 
-  std::ofstream o(config_file_);
-  if (!o.is_open()) {
-    SZ_LOG_ERROR("Open {} for write failed", config_file_);
+  if (!write_file_atomic(config_file_, config.dump(2))) {
     return SZ_RETCODE_FAILED;
   }
-  o << config.dump(2);
   cfg = config;
 
   SZ_LOG_INFO("Config updated to {}", config_file_);
@@ -526,18 +629,87 @@ SZ_RETCODE Config::read_override_config(json &cfg) {
   return SZ_RETCODE_OK;
 }
 
-SZ_RETCODE Config::write_override_config(const json &cfg) {
-  std::ofstream o(config_override_file_);
-  if (!o.is_open()) {
-    SZ_LOG_WARN("Open {} failed, can't save", config_override_file_);
-    return SZ_RETCODE_FAILED;
+void Config::write_override_config(const json &cfg) {
+  {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    pending_override_ = cfg.dump(2);
+    write_pending_ = true;
   }
+  writer_cond_.notify_all();
 
-  o << cfg.dump(2);
-  return SZ_RETCODE_OK;
+  static std::once_flag writer_started;
+  std::call_once(writer_started, [this]() {
+    std::thread([this]() { writer_loop(); }).detach();
+  });
+}
+
+void Config::writer_loop() {
+  while (true) {
+    std::string content;
+    {
+      std::unique_lock<std::mutex> lock(writer_mutex_);
+      writer_cond_.wait(lock, [this] { return write_pending_; });
+      // Only the newest pending content is written, bursts of changes
+      // coalesce into one write
+      content.swap(pending_override_);
+      write_pending_ = false;
+      writing_ = true;
+    }
+
+    write_file_atomic(config_override_file_, content);
+
+    {
+      std::unique_lock<std::mutex> lock(writer_mutex_);
+      writing_ = false;
+    }
+    writer_cond_.notify_all();
+  }
+}
+
+void Config::flush_override_config() {
+  std::unique_lock<std::mutex> lock(writer_mutex_);
+  writer_cond_.wait(lock, [this] { return !write_pending_ && !writing_; });
+}
+
+json Config::current_json() {
+  json target(get_all());
+  target["user"]["temperature_finetune"] = temperature_finetune_.load();
+  return target;
+}
+
+SZ_UINT32 Config::diff_sections(const ConfigData &prev, const ConfigData &cur) {
+  json prev_json(prev), cur_json(cur);
+
+  SZ_UINT32 sections = 0;
+  for (auto &it : SECTION_NAMES) {
+    if (prev_json.value(it.second, json()) != cur_json.value(it.second, json()))
+      sections |= it.first;
+  }
+  return sections;
+}
+
+void Config::notify(const ConfigChange &change) {
+  for (auto &it : SECTION_NAMES) {
+    if (change.changed(it.first)) dispatch(it.second, change);
+  }
+}
+
+ConfigChange Config::apply(const json &config) {
+  ConfigData cfg_data;
+  config.get_to(cfg_data);
+
+  ConfigChange change;
+  change.prev = get_snapshot();
+  publish(cfg_data);
+  change.cur = get_snapshot();
+  change.sections = diff_sections(change.prev->data, change.cur->data);
+  return change;
 }
 
 SZ_RETCODE Config::reload() {
+  flush_override_config();
+
+  ConfigChange change;
   {
     std::unique_lock<std::mutex> lock(cfg_mutex_);
 
@@ -547,6 +719,7 @@ SZ_RETCODE Config::reload() {
     if (ret != SZ_RETCODE_OK) {
       return ret;
     }
+    base_json_ = config;
 
     try {
       json config_patch;
@@ -566,46 +739,50 @@ SZ_RETCODE Config::reload() {
             patch_updated = true;
           }
         }
-        if (patch_updated) {
-          ret = write_override_config(config_patch);
-          if (ret != SZ_RETCODE_OK) {
-            return ret;
-          }
-        }
+        if (patch_updated) write_override_config(config_patch);
         config = config.patch(config_patch);
       }
 
-      config.get_to(cfg_data_);
+      change = apply(config);
     } catch (std::exception &exc) {
       SZ_LOG_ERROR("Load error, will using defaults: {}", exc.what());
-      config.get_to(cfg_data_);
-      dispatch("reload");
-      return SZ_RETCODE_OK;
+      change = apply(base_json_);
     }
   }
 
-  dispatch("reload");
+  notify(change);
 
   return SZ_RETCODE_OK;
 }
 
-SZ_RETCODE Config::save_diff(const json &target_patch) {
-  try {
-    json source;
-    SZ_RETCODE ret = read_config(source);
-    if (ret != SZ_RETCODE_OK) {
-      return ret;
+SZ_RETCODE Config::apply_patch(const json &target_patch) {
+  ConfigChange change;
+  {
+    std::unique_lock<std::mutex> lock(cfg_mutex_);
+    try {
+      json target = current_json();
+      target.merge_patch(target_patch);
+
+      change = apply(target);
+      write_override_config(json::diff(base_json_, target));
+    } catch (std::exception &exc) {
+      SZ_LOG_ERROR("Apply patch error: {}", exc.what());
+      return SZ_RETCODE_FAILED;
     }
+  }
 
-    json target(cfg_data_);
-    target.merge_patch(target_patch);
+  notify(change);
 
-    json diff = json::diff(source, target);
+  return SZ_RETCODE_OK;
+}
 
-    ret = write_override_config(diff);
-    if (ret != SZ_RETCODE_OK) {
-      return ret;
-    }
+SZ_RETCODE Config::save_diff(const json &target_patch) {
+  std::unique_lock<std::mutex> lock(cfg_mutex_);
+  try {
+    json target = current_json();
+    target.merge_patch(target_patch);
+
+    write_override_config(json::diff(base_json_, target));
   } catch (std::exception &exc) {
     SZ_LOG_ERROR("Save diff error: {}", exc.what());
     return SZ_RETCODE_FAILED;
@@ -616,14 +793,17 @@ SZ_RETCODE Config::save_diff(const json &target_patch) {
 
 SZ_RETCODE Config::reset() {
   SZ_LOG_INFO("Clear everything in {} ...", config_override_file_);
-  std::ofstream o(config_override_file_);
-  if (!o.is_open()) {
-    SZ_LOG_WARN("Open {} failed, can't save", config_override_file_);
-    return SZ_RETCODE_FAILED;
+
+  ConfigChange change;
+  {
+    std::unique_lock<std::mutex> lock(cfg_mutex_);
+    write_override_config(json::object());
+    change = apply(base_json_);
   }
 
-  o << "{}";
-  return reload();
+  notify(change);
+
+  return SZ_RETCODE_OK;
 }
 
 bool Config::load_screen_type(LCDScreenType &lcd_screen_type) {
@@ -774,32 +954,36 @@ bool Config::display_temperature() {
 
 void Config::set_temperature_finetune(float diff) {
   std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  instance_.cfg_data_.user.temperature_finetune += diff;
-  if (instance_.cfg_data_.user.temperature_finetune > 2)
-    instance_.cfg_data_.user.temperature_finetune = 2;
-  if (instance_.cfg_data_.user.temperature_finetune < -2)
-    instance_.cfg_data_.user.temperature_finetune = -2;
+  float finetune = instance_.temperature_finetune_.load() + diff;
+  if (finetune > 2) finetune = 2;
+  if (finetune < -2) finetune = -2;
+  instance_.temperature_finetune_.store(finetune);
 }
 
 float Config::get_temperature_bias() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.user.temperature_finetune +
-         instance_.cfg_data_.user.temperature_bias;
+  return instance_.temperature_finetune_.load() +
+         get_user().temperature_bias;
 }
 
-const ConfigData &Config::get_all() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_;
+const TemperatureCalibration &Config::get_temperature_calibration() {
+  static const TemperatureCalibration IDENTITY = {};
+
+  auto &cfg = get_temperature();
+  auto it = cfg.calibrations.find(std::to_string(cfg.manufacturer));
+  if (it == cfg.calibrations.end()) it = cfg.calibrations.find("default");
+  return it == cfg.calibrations.end() ? IDENTITY : it->second;
 }
 
-const UserConfig &Config::get_user() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.user;
+std::shared_ptr<const ConfigSnapshot> Config::get_snapshot() {
+  return std::atomic_load(&instance_.snapshot_);
 }
 
+const ConfigData &Config::get_all() { return get_snapshot()->data; }
+
+const UserConfig &Config::get_user() { return get_snapshot()->data.user; }
+
 std::string Config::get_user_lang() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  std::string lang = instance_.cfg_data_.user.lang;
+  std::string lang = get_user().lang;
   if (lang.find("en") == 0) {
     lang = "en";
   }
@@ -810,55 +994,36 @@ std::string Config::get_user_lang() {
 }
 
 const TemperatureConfig &Config::get_temperature() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.temperature;
+  return get_snapshot()->data.temperature;
 }
 
-const AppConfig &Config::get_app() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.app;
-}
+const AppConfig &Config::get_app() { return get_snapshot()->data.app; }
 
 const QufaceConfig &Config::get_quface() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.quface;
+  return get_snapshot()->data.quface;
 }
 
 const CameraConfig &Config::get_camera(io::CameraType tp) {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
+  auto snapshot = get_snapshot();
   if (tp == io::CAMERA_BGR)
-    return instance_.cfg_data_.normal;
+    return snapshot->data.normal;
   else
-    return instance_.cfg_data_.infrared;
+    return snapshot->data.infrared;
 }
 
-const DetectConfig &Config::get_detect() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  auto &i = instance_;
-  return i.cfg_data_.detect_levels_.get(i.cfg_data_.user.detect_level);
-}
+const DetectConfig &Config::get_detect() { return get_snapshot()->detect; }
 
-const ExtractConfig &Config::get_extract() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  auto &i = instance_;
-  return i.cfg_data_.extract_levels_.get(i.cfg_data_.user.extract_level);
-}
+const ExtractConfig &Config::get_extract() { return get_snapshot()->extract; }
 
 const LivenessConfig &Config::get_liveness() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  auto &i = instance_;
-  return i.cfg_data_.liveness_levels_.get(i.cfg_data_.user.liveness_level);
+  return get_snapshot()->liveness;
 }
 
 bool Config::enable_anti_spoofing() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.user.enable_anti_spoofing;
+  return get_user().enable_anti_spoofing;
 }
 
-bool Config::has_touch_screen() {
-  std::unique_lock<std::mutex> lock(instance_.cfg_mutex_);
-  return instance_.cfg_data_.app.has_touch_screen;
-}
+bool Config::has_touch_screen() { return get_app().has_touch_screen; }
 
 bool Config::read_image(const std::string &image, const std::string &fallback,
                         std::vector<SZ_BYTE> &data) {
@@ -875,11 +1040,11 @@ bool Config::read_image(const std::string &image, const std::string &fallback,
 }
 
 bool Config::read_boot_background(std::vector<SZ_BYTE> &data) {
-  std::string filename = Config().get_app().boot_image_path;
+  std::string filename = Config::get_app().boot_image_path;
   return read_image(filename, ":asserts/boot.jpg", data);
 }
 
 bool Config::read_screen_saver_background(std::vector<SZ_BYTE> &data) {
-  std::string filename = Config().get_app().screensaver_image_path;
+  std::string filename = Config::get_app().screensaver_image_path;
   return read_image(filename, ":asserts/background.jpg", data);
 }
@@ -3,9 +3,17 @@
 
 #include <eventpp/eventdispatcher.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
@@ -14,6 +22,8 @@
 #include <quface/common.hpp>
 #include <quface/logger.hpp>
 
+#include "calibration_curve.hpp"
+
 #define APP_DIR_PREFIX "/user/quface-app"
 
 #define LOAD_JSON_TO(config, key, value) \
@@ -120,10 +130,14 @@ typedef struct {
   SZ_FLOAT temperature_delay;
   int manufacturer;
   TemperatureRotation sensor_rotation;
+  int sensor_width;
+  int sensor_height;
   SZ_FLOAT min_x;
   SZ_FLOAT max_x;
   SZ_FLOAT min_y;
   SZ_FLOAT max_y;
+  // Keyed by the manufacturer, "default" is used for the others
+  std::map<std::string, TemperatureCalibration> calibrations;
 } TemperatureConfig;
 
 void to_json(json &j, const TemperatureConfig &c);
@@ -197,7 +211,7 @@ struct Levels {
   T high;
   T medium;
   T low;
-  T &get(const std::string &level) {
+  const T &get(const std::string &level) const {
     if (level == "high") {
       return high;
     } else if (level == "medium") {
@@ -238,7 +252,40 @@ typedef struct {
 void from_json(const json &j, ConfigData &c);
 void to_json(json &j, const ConfigData &c);
 
-typedef eventpp::EventDispatcher<std::string, void()> ConfigEventEmitter;
+// Immutable version of the configuration, a new one is published on every
+// reload. The levels selected by the user config are resolved once here.
+// Not copyable, the level references point into its own data.
+struct ConfigSnapshot {
+  ConfigSnapshot(const ConfigData &data);
+  ConfigSnapshot(const ConfigSnapshot &) = delete;
+  ConfigSnapshot &operator=(const ConfigSnapshot &) = delete;
+
+  const ConfigData data;
+  const DetectConfig &detect;
+  const ExtractConfig &extract;
+  const LivenessConfig &liveness;
+};
+
+typedef enum ConfigSection {
+  SECTION_USER = 1,
+  SECTION_APP = 2,
+  SECTION_TEMPERATURE = 4,
+  SECTION_QUFACE = 8,
+  SECTION_CAMERAS = 16,
+  SECTION_PRO = 32,
+} ConfigSection;
+
+// Passed to the listeners of each changed section, e.g. "user" or "app"
+typedef struct ConfigChange {
+  std::shared_ptr<const ConfigSnapshot> prev;
+  std::shared_ptr<const ConfigSnapshot> cur;
+  SZ_UINT32 sections;
+
+  bool changed(ConfigSection section) const { return sections & section; }
+} ConfigChange;
+
+typedef eventpp::EventDispatcher<std::string, void(const ConfigChange &)>
+    ConfigEventEmitter;
 
 class Config : public ConfigEventEmitter {
  public:
@@ -249,6 +296,9 @@ class Config : public ConfigEventEmitter {
   SZ_RETCODE load_from_file(const std::string &config_file,
                             const std::string &config_override_file);
   SZ_RETCODE reload();
+  // Apply the patch in memory and notify the changed sections, the override
+  // file is written in background
+  SZ_RETCODE apply_patch(const json &target);
   SZ_RETCODE save_diff(const json &target);
   SZ_RETCODE reset();
   static bool load_screen_type(io::LCDScreenType &lcd_screen_type);
@@ -262,6 +312,11 @@ class Config : public ConfigEventEmitter {
   static bool display_temperature();
   static void set_temperature_finetune(float bias);
   static float get_temperature_bias();
+  static const TemperatureCalibration &get_temperature_calibration();
+
+  // Readers which need several values of one consistent version, e.g. for a
+  // whole frame, should fetch the snapshot once and hold it
+  static std::shared_ptr<const ConfigSnapshot> get_snapshot();
 
   static const ConfigData &get_all();
   static const UserConfig &get_user();
@@ -282,18 +337,53 @@ class Config : public ConfigEventEmitter {
   static bool read_screen_saver_background(std::vector<SZ_BYTE> &data);
 
  private:
+  Config();
+  ~Config();
+
   void load_defaults(ConfigData &c);
+  void publish(const ConfigData &data);
+  ConfigChange apply(const json &config);
+  void notify(const ConfigChange &change);
+  json current_json();
+  static SZ_UINT32 diff_sections(const ConfigData &prev, const ConfigData &cur);
+
   SZ_RETCODE read_config(json &cfg);
   SZ_RETCODE read_override_config(json &cfg);
-  SZ_RETCODE write_override_config(const json &cfg);
+  void write_override_config(const json &cfg);
+  void flush_override_config();
+  void writer_loop();
+  static bool write_file_atomic(const std::string &filename,
+                                const std::string &content);
 
   static bool read_image(const std::string &image, const std::string &fallback,
                          std::vector<SZ_BYTE> &data);
 
  private:
+  // The getters return references into the snapshot without holding it, a
+  // replaced snapshot is kept this long before it is freed. Readers only keep
+  // such references within a frame or a request.
+  static constexpr int RETIRE_DELAY_S = 60;
+
+  // Serializes writers only, readers load snapshot_ with std::atomic_load
   mutable std::mutex cfg_mutex_;
-  ConfigData cfg_data_;
+  std::shared_ptr<const ConfigSnapshot> snapshot_;
+  // Replaced snapshots with the time they were replaced, oldest first
+  std::deque<std::pair<std::chrono::steady_clock::time_point,
+                       std::shared_ptr<const ConfigSnapshot>>>
+      retired_;
+  // Adjusted at runtime by the temperature calibration, reset on reload
+  std::atomic<float> temperature_finetune_;
+  // Defaults merged with config file, the override file is a diff against it
+  json base_json_;
   static Config instance_;
+  static const std::vector<std::pair<ConfigSection, std::string>>
+      SECTION_NAMES;
+
+  std::mutex writer_mutex_;
+  std::condition_variable writer_cond_;
+  std::string pending_override_;
+  bool write_pending_;
+  bool writing_;
 
   std::string config_file_;
   std::string config_override_file_;
@@ -8,14 +8,17 @@ using namespace suanzi;
 
 void DetectionRatio::scale(int x_scale, int y_scale, FaceDetection &detection,
                            FacePose &pose) {
-  detection.bbox.x = x * x_scale;
-  detection.bbox.y = y * y_scale;
-  detection.bbox.width = width * x_scale;
-  detection.bbox.height = height * y_scale;
+  auto bbox = geometry::scale(box(), x_scale, y_scale);
+  detection.bbox.x = bbox.x;
+  detection.bbox.y = bbox.y;
+  detection.bbox.width = bbox.width;
+  detection.bbox.height = bbox.height;
 
   for (int i = 0; i < SZ_LANDMARK_NUM; i++) {
-    pose.landmarks.point[i].x = landmark[i][0] * x_scale;
-    pose.landmarks.point[i].y = landmark[i][1] * y_scale;
+    auto point = geometry::scale({landmark[i][0], landmark[i][1]}, x_scale,
+                                 y_scale);
+    pose.landmarks.point[i].x = point.x;
+    pose.landmarks.point[i].y = point.y;
   }
   pose.yaw = yaw;
   pose.pitch = pitch;
@@ -23,27 +26,29 @@ void DetectionRatio::scale(int x_scale, int y_scale, FaceDetection &detection,
 }
 
 bool DetectionRatio::is_overlap(DetectionRatio other) {
-  float x1 = x, x2 = other.x;
-  float y1 = y, y2 = other.y;
+  return is_overlap(other, *Config::get_snapshot());
+}
+
+bool DetectionRatio::is_overlap(const DetectionRatio &other,
+                                const ConfigSnapshot &snapshot) {
   float w1 = width, w2 = other.width;
   float h1 = height, h2 = other.height;
 
-  if (x1 > x2 + w2 || y1 > y2 + h2 || x1 + w1 < x2 || y1 + h1 < y2)
-    return false;
+  auto a = box(), b = other.box();
+  if (geometry::is_disjoint(a, b)) return false;
 
-  float overlay_w = std::min(x1 + w1, x2 + w2) - std::max(x1, x2);
-  float overlay_h = std::min(y1 + h1, y2 + h2) - std::max(y1, y2);
-  float iou = overlay_w * overlay_h / (w1 * h1 + w2 * h2) * 2;
+  float iou = geometry::dice(a, b);
 
-  auto cfg = Config::get_liveness();
+  auto &cfg = snapshot.liveness;
   bool ret = iou > cfg.min_iou_between_bgr &&
              w1 / w2 >= cfg.min_width_ratio_between_bgr &&
              w1 / w2 <= cfg.max_width_ratio_between_bgr &&
              h1 / h2 >= cfg.min_height_ratio_between_bgr &&
              h1 / h2 <= cfg.max_height_ratio_between_bgr;
   if (!ret) {
-    SZ_LOG_DEBUG("bgr=[{:.2f}, {:.2f}, {:.2f}, {:.2f}]", x1, y1, w1, h1);
-    SZ_LOG_DEBUG("nir=[{:.2f}, {:.2f}, {:.2f}, {:.2f}]", x2, y2, w2, h2);
+    SZ_LOG_DEBUG("bgr=[{:.2f}, {:.2f}, {:.2f}, {:.2f}]", x, y, w1, h1);
+    SZ_LOG_DEBUG("nir=[{:.2f}, {:.2f}, {:.2f}, {:.2f}]", other.x, other.y, w2,
+                 h2);
     SZ_LOG_DEBUG("iou = {:.2f}, w1 / w1 = {:.2f}, h1 / h2 = {:.2f}", iou,
                  w1 / w2, h1 / h2);
   }
@@ -51,7 +56,11 @@ bool DetectionRatio::is_overlap(DetectionRatio other) {
 }
 
 bool DetectionRatio::is_valid_pose() {
-  auto detect = Config::get_detect();
+  return is_valid_pose(*Config::get_snapshot());
+}
+
+bool DetectionRatio::is_valid_pose(const ConfigSnapshot &snapshot) {
+  auto &detect = snapshot.detect;
   return !std::isnan(yaw) && !std::isnan(pitch) && !std::isnan(roll) &&
          detect.min_yaw < yaw && yaw < detect.max_yaw &&
          detect.min_pitch < pitch && pitch < detect.max_pitch &&
@@ -59,11 +68,12 @@ bool DetectionRatio::is_valid_pose() {
 }
 
 bool DetectionRatio::is_valid_position() {
-  auto user = Config::get_user();
-  auto temperature = Config::get_temperature();
+  return is_valid_position(*Config::get_snapshot());
+}
 
+bool DetectionRatio::is_valid_position(const ConfigSnapshot &snapshot) {
   float min_x, min_y, max_x, max_y;
-  if (!user.enable_temperature) {
+  if (!snapshot.data.user.enable_temperature) {
     min_x = min_y = 0.01;
     max_x = max_y = 0.99;
   } else {
@@ -77,9 +87,12 @@ bool DetectionRatio::is_valid_position() {
 }
 
 bool DetectionRatio::is_valid_size() {
-  auto temperature = Config::get_temperature();
-  auto user = Config::get_user();
-  if (!user.enable_temperature)
+  return is_valid_size(*Config::get_snapshot());
+}
+
+bool DetectionRatio::is_valid_size(const ConfigSnapshot &snapshot) {
+  auto &temperature = snapshot.data.temperature;
+  if (!snapshot.data.user.enable_temperature)
     return true;
   else {
     float min_width =
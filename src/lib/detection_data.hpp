@@ -3,11 +3,14 @@
 
 #include <QMetaType>
 
+#include "geometry.hpp"
 #include "image_package.hpp"
 #include "quface/common.hpp"
 
 namespace suanzi {
 
+struct ConfigSnapshot;
+
 struct DetectionRatio {
   float x;
   float y;
@@ -18,12 +21,21 @@ struct DetectionRatio {
   float pitch;
   float roll;
 
+  geometry::Box box() const { return {x, y, width, height}; }
+
   void scale(int x_scale, int y_scale, FaceDetection &detection,
              FacePose &pose);
+
+  // Checks against the current config, the overloads taking a snapshot let
+  // a caller validate a whole frame with one config version
   bool is_overlap(DetectionRatio other);
+  bool is_overlap(const DetectionRatio &other, const ConfigSnapshot &cfg);
   bool is_valid_pose();
+  bool is_valid_pose(const ConfigSnapshot &cfg);
   bool is_valid_position();
+  bool is_valid_position(const ConfigSnapshot &cfg);
   bool is_valid_size();
+  bool is_valid_size(const ConfigSnapshot &cfg);
 };
 
 class DetectionData : public ImagePackage {
@@ -0,0 +1,401 @@
+#include "face_journal.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.hpp"
+
+using namespace suanzi;
+
+constexpr SZ_UINT32 FaceJournal::RECORD_MAGIC;
+constexpr int FaceJournal::COMPACT_RECORDS;
+constexpr int FaceJournal::COMPACT_IDLE_SECONDS;
+
+FaceJournal *FaceJournal::get_instance() {
+  static FaceJournal instance;
+  return &instance;
+}
+
+FaceJournal::FaceJournal()
+    : fp_(nullptr),
+      records_(0),
+      sequence_(0),
+      saved_sequence_(0),
+      compacting_(false),
+      stop_(false) {
+  auto &quface = Config::get_quface();
+  face_database_ = std::make_shared<FaceDatabase>(quface.db_name);
+  filename_ = quface.db_name + ".journal";
+  sequence_filename_ = filename_ + ".seq";
+
+  replay();
+
+  fp_ = fopen(filename_.c_str(), "ab");
+  if (fp_ == nullptr) {
+    SZ_LOG_ERROR("Open {} failed, mutations will be saved directly",
+                 filename_);
+  }
+
+  // Fold the replayed records into the database snapshot right away
+  if (records_ > 0) compact();
+
+  compactor_ = std::thread([this]() { run(); });
+}
+
+FaceJournal::~FaceJournal() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (compactor_.joinable()) compactor_.join();
+
+  compact();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (fp_) fclose(fp_);
+}
+
+SZ_UINT32 FaceJournal::checksum(const RecordHeader &header,
+                                const FaceFeature *feature) {
+  // FNV-1a over the header fields and the feature
+  SZ_UINT32 hash = 2166136261u;
+  auto update = [&hash](const void *data, size_t size) {
+    const SZ_UINT8 *bytes = (const SZ_UINT8 *)data;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 16777619u;
+    }
+  };
+  update(&header.sequence, sizeof(header.sequence));
+  update(&header.op, sizeof(header.op));
+  update(&header.face_id, sizeof(header.face_id));
+  update(&header.weight, sizeof(header.weight));
+  if (feature) update(feature->value, SZ_FEATURE_NUM * sizeof(SZ_FLOAT));
+  return hash;
+}
+
+void FaceJournal::replay() {
+  saved_sequence_ = saved_sequence();
+  sequence_ = saved_sequence_;
+
+  FILE *fp = fopen(filename_.c_str(), "rb");
+  if (fp == nullptr) return;
+
+  static Mutation mutation;
+  long valid_size = 0;
+  int skipped = 0;
+  while (true) {
+    RecordHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1) break;
+    if (header.magic != RECORD_MAGIC) break;
+
+    bool with_feature = has_feature(header.op);
+    if (with_feature && fread(mutation.feature.value, sizeof(SZ_FLOAT),
+                              SZ_FEATURE_NUM, fp) != SZ_FEATURE_NUM)
+      break;
+    if (checksum(header, with_feature ? &mutation.feature : nullptr) !=
+        header.checksum)
+      break;
+    valid_size = ftell(fp);
+
+    // Already in the saved database, the journal was not truncated yet
+    if (header.sequence <= saved_sequence_) {
+      skipped++;
+      continue;
+    }
+
+    mutation.op = (Op)header.op;
+    mutation.face_id = header.face_id;
+    mutation.weight = header.weight;
+    apply(mutation);
+    records_++;
+    sequence_ = header.sequence;
+  }
+  fclose(fp);
+
+  // A torn record at the tail is left by a crash during append
+  if (truncate(filename_.c_str(), valid_size) != 0) {
+    SZ_LOG_WARN("Truncate {} failed", filename_);
+  }
+
+  SZ_LOG_INFO("Replayed {} face database records from {}, {} already saved",
+              records_, filename_, skipped);
+}
+
+SZ_RETCODE FaceJournal::apply(const Mutation &mutation) {
+  std::unique_lock<RWLock> lock(database_lock_);
+  switch (mutation.op) {
+    case OP_ADD:
+      return face_database_->add(mutation.face_id, mutation.feature);
+    case OP_ADD_WEIGHTED:
+      return face_database_->add(mutation.face_id, mutation.feature,
+                                 mutation.weight);
+    case OP_REMOVE:
+      return face_database_->remove(mutation.face_id);
+    case OP_CLEAR:
+      return face_database_->clear();
+  }
+  return SZ_RETCODE_FAILED;
+}
+
+SZ_RETCODE FaceJournal::append(const Mutation &mutation) {
+  if (fp_ == nullptr) return SZ_RETCODE_FAILED;
+
+  bool with_feature = has_feature(mutation.op);
+  RecordHeader header = {RECORD_MAGIC,     sequence_ + 1,   mutation.op,
+                         mutation.face_id, mutation.weight, 0};
+  header.checksum =
+      checksum(header, with_feature ? &mutation.feature : nullptr);
+
+  fseek(fp_, 0, SEEK_END);
+  long offset = ftell(fp_);
+  bool ok = fwrite(&header, sizeof(header), 1, fp_) == 1;
+  if (ok && with_feature)
+    ok = fwrite(mutation.feature.value, sizeof(SZ_FLOAT), SZ_FEATURE_NUM,
+                fp_) == SZ_FEATURE_NUM;
+  ok = ok && fflush(fp_) == 0 && fdatasync(fileno(fp_)) == 0;
+  if (!ok) {
+    // Records behind a torn one would be lost on replay
+    clearerr(fp_);
+    if (offset < 0 || ftruncate(fileno(fp_), offset) != 0)
+      SZ_LOG_ERROR("Truncate {} failed", filename_);
+    SZ_LOG_ERROR("Append to {} failed", filename_);
+    return SZ_RETCODE_FAILED;
+  }
+
+  sequence_ = header.sequence;
+  records_++;
+  last_append_ = std::chrono::steady_clock::now();
+  if (records_ >= COMPACT_RECORDS) cond_.notify_all();
+  return SZ_RETCODE_OK;
+}
+
+SZ_RETCODE FaceJournal::mutate(const Mutation &mutation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (compacting_) {
+    // The database is being saved, it is changed when the save is over
+    SZ_RETCODE ret = append(mutation);
+    if (ret == SZ_RETCODE_OK) pending_.push_back(mutation);
+    return ret;
+  }
+
+  SZ_RETCODE ret = apply(mutation);
+  if (ret != SZ_RETCODE_OK) return ret;
+  if (append(mutation) == SZ_RETCODE_OK) return SZ_RETCODE_OK;
+  return save_snapshot(sequence_);
+}
+
+SZ_RETCODE FaceJournal::add(SZ_UINT32 face_id, const FaceFeature &feature) {
+  return mutate({OP_ADD, face_id, 0, feature});
+}
+
+SZ_RETCODE FaceJournal::add(SZ_UINT32 face_id, const FaceFeature &feature,
+                            SZ_FLOAT weight) {
+  return mutate({OP_ADD_WEIGHTED, face_id, weight, feature});
+}
+
+SZ_RETCODE FaceJournal::remove(SZ_UINT32 face_id) {
+  return mutate({OP_REMOVE, face_id, 0, {}});
+}
+
+SZ_RETCODE FaceJournal::clear() {
+  SZ_RETCODE ret = mutate({OP_CLEAR, 0, 0, {}});
+  if (ret != SZ_RETCODE_OK) return ret;
+  // Nothing before a clear matters, start over from an empty snapshot
+  return compact();
+}
+
+SZ_RETCODE FaceJournal::query(const FaceFeature &feature, SZ_INT32 top_k,
+                              std::vector<QueryResult> &results) {
+  ReadLock lock(database_lock_);
+  return face_database_->query(feature, top_k, results);
+}
+
+SZ_RETCODE FaceJournal::size(SZ_UINT32 &size) {
+  ReadLock lock(database_lock_);
+  return face_database_->size(size);
+}
+
+SZ_RETCODE FaceJournal::list(std::vector<SZ_UINT32> &face_ids) {
+  ReadLock lock(database_lock_);
+  return face_database_->list(face_ids);
+}
+
+SZ_RETCODE FaceJournal::compact() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (compacting_ || records_ == 0) return SZ_RETCODE_OK;
+
+  compacting_ = true;
+  SZ_UINT32 sequence = sequence_;
+  int records = records_;
+  long offset = 0;
+  if (fp_ && fseek(fp_, 0, SEEK_END) == 0) offset = ftell(fp_);
+  lock.unlock();
+
+  SZ_RETCODE ret = save_snapshot(sequence);
+
+  lock.lock();
+  if (ret == SZ_RETCODE_OK) {
+    drop_records(offset);
+    records_ -= records;
+    SZ_LOG_INFO("Compacted {} face database records", records);
+  }
+
+  for (auto &mutation : pending_) {
+    if (apply(mutation) != SZ_RETCODE_OK)
+      SZ_LOG_WARN("Apply face database record of {} failed",
+                  mutation.face_id);
+  }
+  pending_.clear();
+  compacting_ = false;
+  return ret;
+}
+
+void FaceJournal::drop_records(long offset) {
+  if (fp_ == nullptr || offset < 0) return;
+
+  fseek(fp_, 0, SEEK_END);
+  long size = ftell(fp_);
+  if (size == offset) {
+    if (ftruncate(fileno(fp_), 0) != 0)
+      SZ_LOG_WARN("Truncate {} failed", filename_);
+    return;
+  }
+
+  // Keep the records appended during the save. If this fails the saved
+  // records stay, they are skipped by their sequence on replay.
+  std::vector<char> tail(size - offset);
+  FILE *in = fopen(filename_.c_str(), "rb");
+  bool ok = in && fseek(in, offset, SEEK_SET) == 0 &&
+            fread(tail.data(), 1, tail.size(), in) == tail.size();
+  if (in) fclose(in);
+
+  std::string tmp_filename = filename_ + ".tmp";
+  FILE *out = ok ? fopen(tmp_filename.c_str(), "wb") : nullptr;
+  ok = out && fwrite(tail.data(), 1, tail.size(), out) == tail.size() &&
+       fflush(out) == 0 && fdatasync(fileno(out)) == 0;
+  if (out) fclose(out);
+  if (!ok || rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+    SZ_LOG_WARN("Drop saved records from {} failed", filename_);
+    return;
+  }
+
+  fclose(fp_);
+  fp_ = fopen(filename_.c_str(), "ab");
+  if (fp_ == nullptr)
+    SZ_LOG_ERROR("Open {} failed, mutations will be saved directly",
+                 filename_);
+}
+
+void FaceJournal::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    cond_.wait_for(lock, std::chrono::seconds(COMPACT_IDLE_SECONDS));
+    if (stop_ || records_ == 0 || compacting_) continue;
+
+    // Compact when the journal is long, or once a burst of mutations is over
+    auto idle = std::chrono::steady_clock::now() - last_append_;
+    if (records_ >= COMPACT_RECORDS ||
+        idle >= std::chrono::seconds(COMPACT_IDLE_SECONDS)) {
+      lock.unlock();
+      compact();
+      lock.lock();
+    }
+  }
+}
+
+SZ_RETCODE FaceJournal::save_snapshot(SZ_UINT32 sequence) {
+  // The coarse clock is the one the file system stamps files with
+  timespec started;
+  clock_gettime(CLOCK_REALTIME_COARSE, &started);
+  if (!write_sequence(saved_sequence_, sequence, started)) {
+    SZ_LOG_ERROR("Write {} failed, keep journal", sequence_filename_);
+    return SZ_RETCODE_FAILED;
+  }
+
+  SZ_RETCODE ret;
+  {
+    ReadLock lock(database_lock_);
+    ret = face_database_->save();
+  }
+  if (ret != SZ_RETCODE_OK) {
+    SZ_LOG_ERROR("Save face database failed, keep journal");
+    return ret;
+  }
+
+  // If this fails, replay tells from the database files that it was saved
+  if (!write_sequence(sequence, sequence, started))
+    SZ_LOG_WARN("Write {} failed", sequence_filename_);
+  saved_sequence_ = sequence;
+  return SZ_RETCODE_OK;
+}
+
+SZ_UINT32 FaceJournal::saved_sequence() {
+  FILE *fp = fopen(sequence_filename_.c_str(), "r");
+  if (fp == nullptr) return 0;
+
+  unsigned committed = 0, pending = 0;
+  long long sec = 0, nsec = 0;
+  int n = fscanf(fp, "%u %u %lld %lld", &committed, &pending, &sec, &nsec);
+  fclose(fp);
+  if (n != 4) {
+    SZ_LOG_WARN("Invalid {}, replay the whole journal", sequence_filename_);
+    return 0;
+  }
+  if (committed == pending) return committed;
+
+  // Interrupted during a compaction, the records up to pending are in the
+  // database only if it has been written since
+  timespec started = {(time_t)sec, (long)nsec};
+  return database_saved_since(started) ? pending : committed;
+}
+
+bool FaceJournal::write_sequence(SZ_UINT32 committed, SZ_UINT32 pending,
+                                 const timespec &started) {
+  std::string tmp_filename = sequence_filename_ + ".tmp";
+  FILE *fp = fopen(tmp_filename.c_str(), "w");
+  if (fp == nullptr) return false;
+
+  bool ok = fprintf(fp, "%u %u %lld %lld\n", (unsigned)committed,
+                    (unsigned)pending, (long long)started.tv_sec,
+                    (long long)started.tv_nsec) > 0 &&
+            fflush(fp) == 0 && fdatasync(fileno(fp)) == 0;
+  fclose(fp);
+  return ok && rename(tmp_filename.c_str(), sequence_filename_.c_str()) == 0;
+}
+
+bool FaceJournal::database_saved_since(const timespec &started) {
+  // The SDK writes its files next to db_name with it as prefix, the journal
+  // and the templates are the files of the app
+  auto &db_name = Config::get_quface().db_name;
+  auto slash = db_name.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : db_name.substr(0, slash);
+  std::string base =
+      slash == std::string::npos ? db_name : db_name.substr(slash + 1);
+
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) return false;
+
+  bool saved = false;
+  while (struct dirent *entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, base.size(), base) != 0) continue;
+    std::string suffix = name.substr(base.size());
+    if (suffix.compare(0, 8, ".journal") == 0 ||
+        suffix.compare(0, 10, ".templates") == 0)
+      continue;
+
+    struct stat st;
+    if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+    if (st.st_mtim.tv_sec > started.tv_sec ||
+        (st.st_mtim.tv_sec == started.tv_sec &&
+         st.st_mtim.tv_nsec >= started.tv_nsec)) {
+      saved = true;
+      break;
+    }
+  }
+  closedir(d);
+  return saved;
+}
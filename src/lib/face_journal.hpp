@@ -0,0 +1,127 @@
+#ifndef FACE_JOURNAL_H
+#define FACE_JOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "quface_common.hpp"
+#include "rw_lock.hpp"
+
+namespace suanzi {
+
+// Write-ahead log of the face database mutations. Every mutation is applied to
+// the database and appended to the journal, which costs one small write
+// instead of rewriting the whole database. The journal is replayed on
+// startup, and compacted in background by saving the database and dropping
+// the saved records.
+//
+// Records are numbered, the number of the last saved record is kept in
+// <db_name>.journal.seq, so a record is never applied twice. The database is
+// saved without holding the journal lock, mutations meanwhile are journaled
+// at once and applied to the database when the save is over.
+//
+// The SDK does not document FaceDatabase as thread safe, so the database is
+// only reachable through the journal. Queries and saves share a reader lock,
+// mutations take it exclusively.
+class FaceJournal {
+ public:
+  static FaceJournal *get_instance();
+
+  SZ_RETCODE add(SZ_UINT32 face_id, const FaceFeature &feature);
+  // Adapt the templates of face_id with a weighted feature
+  SZ_RETCODE add(SZ_UINT32 face_id, const FaceFeature &feature,
+                 SZ_FLOAT weight);
+  SZ_RETCODE remove(SZ_UINT32 face_id);
+  SZ_RETCODE clear();
+
+  // Save the database and drop the saved records now
+  SZ_RETCODE compact();
+
+  SZ_RETCODE query(const FaceFeature &feature, SZ_INT32 top_k,
+                   std::vector<QueryResult> &results);
+  SZ_RETCODE size(SZ_UINT32 &size);
+  SZ_RETCODE list(std::vector<SZ_UINT32> &face_ids);
+
+ private:
+  FaceJournal();
+  ~FaceJournal();
+
+  typedef enum {
+    OP_ADD = 1,
+    OP_ADD_WEIGHTED = 2,
+    OP_REMOVE = 3,
+    OP_CLEAR = 4,
+  } Op;
+
+  struct RecordHeader {
+    SZ_UINT32 magic;
+    SZ_UINT32 sequence;
+    SZ_UINT32 op;
+    SZ_UINT32 face_id;
+    SZ_FLOAT weight;
+    SZ_UINT32 checksum;
+  };
+
+  static constexpr SZ_UINT32 RECORD_MAGIC = 0x4a5a5346;  // "FSZJ"
+  // Compact after this many records, or when idle for a while
+  static constexpr int COMPACT_RECORDS = 512;
+  static constexpr int COMPACT_IDLE_SECONDS = 30;
+
+  struct Mutation {
+    Op op;
+    SZ_UINT32 face_id;
+    SZ_FLOAT weight;
+    FaceFeature feature;
+  };
+
+  static bool has_feature(SZ_UINT32 op) {
+    return op == OP_ADD || op == OP_ADD_WEIGHTED;
+  }
+  static SZ_UINT32 checksum(const RecordHeader &header,
+                            const FaceFeature *feature);
+
+  SZ_RETCODE mutate(const Mutation &mutation);
+  SZ_RETCODE apply(const Mutation &mutation);
+  SZ_RETCODE append(const Mutation &mutation);
+  void drop_records(long offset);
+  void replay();
+  void run();
+
+  SZ_RETCODE save_snapshot(SZ_UINT32 sequence);
+  SZ_UINT32 saved_sequence();
+  bool write_sequence(SZ_UINT32 committed, SZ_UINT32 pending,
+                      const timespec &started);
+  bool database_saved_since(const timespec &started);
+
+  // The gallery shared by all consumers, it is loaded only once
+  FaceDatabasePtr face_database_;
+  RWLock database_lock_;
+  std::string filename_;
+  std::string sequence_filename_;
+  FILE *fp_;
+  int records_;
+  // Number of the last journaled record, and of the last saved one
+  SZ_UINT32 sequence_;
+  SZ_UINT32 saved_sequence_;
+  std::chrono::steady_clock::time_point last_append_;
+
+  // Mutations journaled while the database is saved
+  bool compacting_;
+  std::vector<Mutation> pending_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool stop_;
+  std::thread compactor_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef FEATURE_H
+#define FEATURE_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include <cassert>
+
+#include <quface/common.hpp>
+
+namespace suanzi {
+
+// Dot product of two normalized SZ_FEATURE_NUM features, i.e. their cosine
+inline float feature_dot(const SZ_FLOAT *a, const SZ_FLOAT *b) {
+  float score = 0.0;
+
+#if __ARM_NEON
+  assert(SZ_FEATURE_NUM % 16 == 0);
+
+  float32x4_t out = vmovq_n_f32(0.0);
+  float32x4_t f1, f2;
+  float out_tmp[4];
+  for (int k = 0; k < SZ_FEATURE_NUM; k += 16) {
+    f1 = vld1q_f32(a + k);
+    f2 = vld1q_f32(b + k);
+    out = vmlaq_f32(out, f1, f2);
+
+    f1 = vld1q_f32(a + k + 4);
+    f2 = vld1q_f32(b + k + 4);
+    out = vmlaq_f32(out, f1, f2);
+
+    f1 = vld1q_f32(a + k + 8);
+    f2 = vld1q_f32(b + k + 8);
+    out = vmlaq_f32(out, f1, f2);
+
+    f1 = vld1q_f32(a + k + 12);
+    f2 = vld1q_f32(b + k + 12);
+    out = vmlaq_f32(out, f1, f2);
+  }
+  vst1q_f32(out_tmp, out);
+
+  score = out_tmp[0] + out_tmp[1] + out_tmp[2] + out_tmp[3];
+#else
+  for (int k = 0; k < SZ_FEATURE_NUM; k++) score += a[k] * b[k];
+#endif
+
+  return score;
+}
+
+// Cosine mapped to [0, 1], the scale of the FaceDatabase query scores
+inline float feature_similarity(const SZ_FLOAT *a, const SZ_FLOAT *b) {
+  return feature_dot(a, b) / 2 + 0.5f;
+}
+
+}  // namespace suanzi
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace suanzi {
+
+namespace geometry {
+
+struct Point {
+  float x;
+  float y;
+};
+
+// Axis aligned box, either in pixels or in ratio of the image size
+struct Box {
+  float x;
+  float y;
+  float width;
+  float height;
+};
+
+constexpr float area(const Box &b) { return b.width * b.height; }
+
+constexpr float right(const Box &b) { return b.x + b.width; }
+
+constexpr float bottom(const Box &b) { return b.y + b.height; }
+
+constexpr Box scale(const Box &b, float x_scale, float y_scale) {
+  return {b.x * x_scale, b.y * y_scale, b.width * x_scale, b.height * y_scale};
+}
+
+constexpr Point scale(const Point &p, float x_scale, float y_scale) {
+  return {p.x * x_scale, p.y * y_scale};
+}
+
+inline bool is_disjoint(const Box &a, const Box &b) {
+  return a.x > right(b) || a.y > bottom(b) || right(a) < b.x ||
+         bottom(a) < b.y;
+}
+
+inline float intersection(const Box &a, const Box &b) {
+  if (is_disjoint(a, b)) return 0;
+  float w = std::min(right(a), right(b)) - std::max(a.x, b.x);
+  float h = std::min(bottom(a), bottom(b)) - std::max(a.y, b.y);
+  return w * h;
+}
+
+// Intersection over union
+inline float iou(const Box &a, const Box &b) {
+  float inter = intersection(a, b);
+  float uni = area(a) + area(b) - inter;
+  return uni > 0 ? inter / uni : 0;
+}
+
+// Dice coefficient 2 * |A ∩ B| / (|A| + |B|), used as the overlap score of
+// the liveness and tracking checks, their thresholds are tuned for it
+inline float dice(const Box &a, const Box &b) {
+  float sum = area(a) + area(b);
+  return sum > 0 ? intersection(a, b) / sum * 2 : 0;
+}
+
+// Intersection over the smallest box containing both
+inline float intersection_over_hull(const Box &a, const Box &b) {
+  float hull_w = std::max(right(a), right(b)) - std::min(a.x, b.x);
+  float hull_h = std::max(bottom(a), bottom(b)) - std::min(a.y, b.y);
+  float hull = hull_w * hull_h;
+  return hull > 0 ? intersection(a, b) / hull : 0;
+}
+
+// Clockwise rotation of ratio coordinates by ROTATE * 90 degrees, ROTATE has
+// the meaning of CameraConfig::rotate
+template <int ROTATE>
+struct Rotation;
+
+template <>
+struct Rotation<0> {
+  static constexpr Point apply(const Point &p) { return p; }
+  static constexpr Box apply(const Box &b) { return b; }
+};
+
+template <>
+struct Rotation<1> {
+  static constexpr Point apply(const Point &p) { return {1 - p.y, p.x}; }
+  static constexpr Box apply(const Box &b) {
+    return {1 - b.y - b.height, b.x, b.height, b.width};
+  }
+};
+
+template <>
+struct Rotation<2> {
+  static constexpr Point apply(const Point &p) { return {1 - p.x, 1 - p.y}; }
+  static constexpr Box apply(const Box &b) {
+    return {1 - b.x - b.width, 1 - b.y - b.height, b.width, b.height};
+  }
+};
+
+template <>
+struct Rotation<3> {
+  static constexpr Point apply(const Point &p) { return {p.y, 1 - p.x}; }
+  static constexpr Box apply(const Box &b) {
+    return {b.y, 1 - b.x - b.width, b.height, b.width};
+  }
+};
+
+template <typename T>
+inline T rotate(const T &v, int rotate) {
+  switch (rotate & 3) {
+    case 1:
+      return Rotation<1>::apply(v);
+    case 2:
+      return Rotation<2>::apply(v);
+    case 3:
+      return Rotation<3>::apply(v);
+    default:
+      return Rotation<0>::apply(v);
+  }
+}
+
+// Structure of arrays of boxes, for scoring many faces against one target
+struct BoxArray {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> width;
+  std::vector<float> height;
+
+  size_t size() const { return x.size(); }
+
+  void clear() {
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+  }
+
+  void push_back(const Box &b) {
+    x.push_back(b.x);
+    y.push_back(b.y);
+    width.push_back(b.width);
+    height.push_back(b.height);
+  }
+
+  Box at(size_t i) const { return {x[i], y[i], width[i], height[i]}; }
+};
+
+// Branch free loops over the arrays, so that the compiler can vectorize them
+inline void intersection(const Box &a, const BoxArray &boxes, float *out) {
+  const size_t n = boxes.size();
+  const float *x = boxes.x.data(), *y = boxes.y.data();
+  const float *w = boxes.width.data(), *h = boxes.height.data();
+  for (size_t i = 0; i < n; i++) {
+    float iw = std::min(right(a), x[i] + w[i]) - std::max(a.x, x[i]);
+    float ih = std::min(bottom(a), y[i] + h[i]) - std::max(a.y, y[i]);
+    out[i] = std::max(iw, 0.f) * std::max(ih, 0.f);
+  }
+}
+
+inline void iou(const Box &a, const BoxArray &boxes, float *out) {
+  intersection(a, boxes, out);
+  const size_t n = boxes.size();
+  const float *w = boxes.width.data(), *h = boxes.height.data();
+  for (size_t i = 0; i < n; i++) {
+    float uni = area(a) + w[i] * h[i] - out[i];
+    out[i] = uni > 0 ? out[i] / uni : 0;
+  }
+}
+
+inline void dice(const Box &a, const BoxArray &boxes, float *out) {
+  intersection(a, boxes, out);
+  const size_t n = boxes.size();
+  const float *w = boxes.width.data(), *h = boxes.height.data();
+  for (size_t i = 0; i < n; i++) {
+    float sum = area(a) + w[i] * h[i];
+    out[i] = sum > 0 ? out[i] / sum * 2 : 0;
+  }
+}
+
+// Index of the largest box, -1 if empty
+inline int select_largest(const BoxArray &boxes) {
+  int max_id = -1;
+  float max_area = 0;
+  for (size_t i = 0; i < boxes.size(); i++) {
+    float a = boxes.width[i] * boxes.height[i];
+    if (max_id < 0 || a > max_area) {
+      max_id = i;
+      max_area = a;
+    }
+  }
+  return max_id;
+}
+
+}  // namespace geometry
+
+}  // namespace suanzi
+
+#endif
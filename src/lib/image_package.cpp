@@ -2,7 +2,11 @@
 
 using namespace suanzi;
 
-ImagePackage::ImagePackage() { frame_idx = 0; }
+ImagePackage::ImagePackage() {
+  frame_idx = 0;
+  bgr_pts = 0;
+  nir_pts = 0;
+}
 
 ImagePackage::ImagePackage(const ImagePackage* pkg) {
   img_bgr_small = new MmzImage(pkg->img_bgr_small->width,
@@ -16,6 +20,8 @@ ImagePackage::ImagePackage(const ImagePackage* pkg) {
                                pkg->img_nir_large->height, SZ_IMAGETYPE_NV21);
 
   frame_idx = pkg->frame_idx;
+  bgr_pts = pkg->bgr_pts;
+  nir_pts = pkg->nir_pts;
 }
 
 ImagePackage::ImagePackage(Size size_bgr_large, Size size_bgr_small,
@@ -31,6 +37,8 @@ ImagePackage::ImagePackage(Size size_bgr_large, Size size_bgr_small,
                                SZ_IMAGETYPE_NV21);
 
   frame_idx = 0;
+  bgr_pts = 0;
+  nir_pts = 0;
 }
 
 ImagePackage::~ImagePackage() {
@@ -47,4 +55,6 @@ void ImagePackage::copy_to(ImagePackage& pkg) {
   img_nir_small->copy_to(*pkg.img_nir_small);
 
   pkg.frame_idx = frame_idx;
+  pkg.bgr_pts = bgr_pts;
+  pkg.nir_pts = nir_pts;
 }
@@ -2,6 +2,7 @@
 #define IMAGE_PACKAGE_H
 
 #include <QMetaType>
+#include <cstdint>
 
 #include <opencv2/opencv.hpp>
 
@@ -24,6 +25,9 @@ class ImagePackage {
 
  public:
   int frame_idx;
+  // Capture time of the BGR / NIR frames, steady clock in microseconds
+  int64_t bgr_pts;
+  int64_t nir_pts;
   MmzImage *img_bgr_small;
   MmzImage *img_bgr_large;
   MmzImage *img_nir_small;
@@ -0,0 +1,100 @@
+#include "model_registry.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include "config.hpp"
+
+using namespace suanzi;
+
+static const char *CONTEXT_NAMES[MODEL_CONTEXT_COUNT] = {"pipeline",
+                                                         "service"};
+
+ModelRegistry *ModelRegistry::get_instance() {
+  static ModelRegistry instance;
+  return &instance;
+}
+
+ModelRegistry::ModelRegistry() {
+  model_file_path_ = Config::get_quface().model_file_path;
+}
+
+size_t ModelRegistry::resident_memory() {
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp == nullptr) return 0;
+
+  unsigned long size = 0, resident = 0;
+  int n = fscanf(fp, "%lu %lu", &size, &resident);
+  fclose(fp);
+  if (n != 2) return 0;
+
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+template <typename T>
+std::shared_ptr<T> ModelRegistry::get(Slot<T> &slot, const char *name,
+                                      ModelContext context) {
+  std::call_once(slot.once, [&]() {
+    auto start = std::chrono::steady_clock::now();
+    size_t rss_before = resident_memory();
+
+    slot.model = std::make_shared<T>(model_file_path_);
+
+    auto load_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    // Approximate when other models load at the same time
+    int64_t rss_delta_kb =
+        ((int64_t)resident_memory() - (int64_t)rss_before) / 1024;
+
+    SZ_LOG_INFO("Loaded {} for {} in {}ms, rss +{}KB", name,
+                CONTEXT_NAMES[context], load_ms, rss_delta_kb);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    records_.push_back({name, context, load_ms, rss_delta_kb});
+  });
+  return slot.model;
+}
+
+FaceDetectorPtr ModelRegistry::detector(ModelContext context) {
+  return get(models_[context].detector, "FaceDetector", context);
+}
+
+FacePoseEstimatorPtr ModelRegistry::pose_estimator(ModelContext context) {
+  return get(models_[context].pose_estimator, "FacePoseEstimator", context);
+}
+
+FaceExtractorPtr ModelRegistry::extractor(ModelContext context) {
+  return get(models_[context].extractor, "FaceExtractor", context);
+}
+
+FaceAntiSpoofingPtr ModelRegistry::anti_spoofing(ModelContext context) {
+  return get(models_[context].anti_spoofing, "FaceAntiSpoofing", context);
+}
+
+MaskDetectorPtr ModelRegistry::mask_detector(ModelContext context) {
+  return get(models_[context].mask_detector, "MaskDetector", context);
+}
+
+void ModelRegistry::preload() {
+  detector();
+  pose_estimator();
+  extractor();
+  anti_spoofing();
+  mask_detector();
+}
+
+void ModelRegistry::report() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  int64_t total_ms = 0;
+  for (auto &r : records_) {
+    SZ_LOG_INFO("Model {}/{}: load={}ms rss=+{}KB", CONTEXT_NAMES[r.context],
+                r.name, r.load_ms, r.rss_delta_kb);
+    total_ms += r.load_ms;
+  }
+  SZ_LOG_INFO("Models loaded={} load_total={}ms rss={}KB", records_.size(),
+              total_ms, resident_memory() / 1024);
+}
@@ -0,0 +1,83 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "quface_common.hpp"
+
+namespace suanzi {
+
+// Execution context of the models. The SDK models are not safe to be used by
+// several threads at the same time, so the instances are shared only inside a
+// context, and every thread running inference belongs to one context
+typedef enum {
+  MODEL_CONTEXT_PIPELINE = 0,  // DetectTask, RecognizeTask
+  MODEL_CONTEXT_SERVICE,       // FaceService, registering faces from the API
+  MODEL_CONTEXT_COUNT,
+} ModelContext;
+
+// Owns the QuFace model instances, so that a model file is loaded once per
+// context instead of once per consumer, and reports the load time and the
+// resident memory growth of each load
+class ModelRegistry {
+ public:
+  static ModelRegistry *get_instance();
+
+  FaceDetectorPtr detector(ModelContext context = MODEL_CONTEXT_PIPELINE);
+  FacePoseEstimatorPtr pose_estimator(
+      ModelContext context = MODEL_CONTEXT_PIPELINE);
+  FaceExtractorPtr extractor(ModelContext context = MODEL_CONTEXT_PIPELINE);
+  FaceAntiSpoofingPtr anti_spoofing(
+      ModelContext context = MODEL_CONTEXT_PIPELINE);
+  MaskDetectorPtr mask_detector(ModelContext context = MODEL_CONTEXT_PIPELINE);
+
+  // Load all the models used by the recognition pipeline
+  void preload();
+
+  // Log the load time and memory of every model loaded so far
+  void report();
+
+  // Resident memory of the process in bytes, 0 if unknown
+  static size_t resident_memory();
+
+ private:
+  ModelRegistry();
+
+  // A model loaded at most once, different models may load concurrently
+  template <typename T>
+  struct Slot {
+    std::shared_ptr<T> model;
+    std::once_flag once;
+  };
+
+  struct Models {
+    Slot<FaceDetector> detector;
+    Slot<FacePoseEstimator> pose_estimator;
+    Slot<FaceExtractor> extractor;
+    Slot<FaceAntiSpoofing> anti_spoofing;
+    Slot<MaskDetector> mask_detector;
+  };
+
+  struct LoadRecord {
+    std::string name;
+    ModelContext context;
+    int64_t load_ms;
+    int64_t rss_delta_kb;
+  };
+
+  template <typename T>
+  std::shared_ptr<T> get(Slot<T> &slot, const char *name,
+                         ModelContext context);
+
+  std::string model_file_path_;
+  Models models_[MODEL_CONTEXT_COUNT];
+  std::vector<LoadRecord> records_;
+  std::mutex mutex_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+#include <pthread.h>
+
+namespace suanzi {
+
+// Reader/writer lock, std::shared_mutex needs C++17. Writers lock it with
+// std::unique_lock, readers with ReadLock.
+class RWLock {
+ public:
+  RWLock() { pthread_rwlock_init(&lock_, nullptr); }
+  ~RWLock() { pthread_rwlock_destroy(&lock_); }
+
+  RWLock(const RWLock &) = delete;
+  RWLock &operator=(const RWLock &) = delete;
+
+  void lock() { pthread_rwlock_wrlock(&lock_); }
+  void lock_shared() { pthread_rwlock_rdlock(&lock_); }
+  void unlock() { pthread_rwlock_unlock(&lock_); }
+
+ private:
+  pthread_rwlock_t lock_;
+};
+
+class ReadLock {
+ public:
+  explicit ReadLock(RWLock &lock) : lock_(lock) { lock_.lock_shared(); }
+  ~ReadLock() { lock_.unlock(); }
+
+  ReadLock(const ReadLock &) = delete;
+  ReadLock &operator=(const ReadLock &) = delete;
+
+ private:
+  RWLock &lock_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -0,0 +1,141 @@
+#include "sequence_voter.hpp"
+
+using namespace suanzi;
+
+constexpr size_t SequenceVoter::CAPACITY;
+
+SequenceVoter::SequenceVoter() { clear(); }
+
+void SequenceVoter::clear() {
+  persons_.clear();
+  lives_.clear();
+  mask_count_[0] = mask_count_[1] = 0;
+  live_count_ = 0;
+  candidate_size_ = 0;
+}
+
+SequenceVoter::Candidate *SequenceVoter::find_candidate(SZ_UINT32 face_id) {
+  for (size_t i = 0; i < candidate_size_; i++) {
+    if (candidates_[i].face_id == face_id) return &candidates_[i];
+  }
+  return nullptr;
+}
+
+const SequenceVoter::Candidate *SequenceVoter::find_candidate(
+    SZ_UINT32 face_id) const {
+  for (size_t i = 0; i < candidate_size_; i++) {
+    if (candidates_[i].face_id == face_id) return &candidates_[i];
+  }
+  return nullptr;
+}
+
+void SequenceVoter::add_person(const QueryResult &person, bool has_mask) {
+  PersonFrame frame = {person.face_id, person.score, has_mask}, evicted;
+  if (persons_.push(frame, evicted)) {
+    mask_count_[evicted.has_mask]--;
+
+    Candidate *candidate = find_candidate(evicted.face_id);
+    candidate->count[evicted.has_mask]--;
+    if (candidate->count[0] == 0 && candidate->count[1] == 0) {
+      *candidate = candidates_[--candidate_size_];
+    }
+  }
+
+  mask_count_[has_mask]++;
+
+  Candidate *candidate = find_candidate(person.face_id);
+  if (candidate == nullptr) {
+    candidate = &candidates_[candidate_size_++];
+    candidate->face_id = person.face_id;
+    candidate->count[0] = candidate->count[1] = 0;
+  }
+  candidate->count[has_mask]++;
+}
+
+void SequenceVoter::add_live(bool is_live) {
+  bool evicted;
+  if (lives_.push(is_live, evicted) && evicted) live_count_--;
+  if (is_live) live_count_++;
+}
+
+bool SequenceVoter::vote_mask(size_t min_count, bool &has_mask) const {
+  if (persons_.size() < min_count) return false;
+  if (mask_count_[0] < (int)min_count && mask_count_[1] < (int)min_count)
+    return false;
+
+  size_t count[2] = {0, 0};
+  for (size_t i = 0; i < persons_.size(); i++) {
+    bool mask = persons_.recent(i).has_mask;
+    if (++count[mask] >= min_count) {
+      has_mask = mask;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SequenceVoter::vote_live(size_t min_count, size_t max_count,
+                              bool &is_live) const {
+  if (lives_.size() < min_count) return false;
+
+  // Fast path when there are not enough live frames in the whole buffer
+  if (live_count_ < (int)min_count) {
+    if (lives_.size() < max_count) return false;
+    is_live = false;
+    return true;
+  }
+
+  size_t live = 0;
+  for (size_t i = 0; i < lives_.size(); i++) {
+    if (lives_.recent(i) && ++live >= min_count) {
+      is_live = true;
+      return true;
+    }
+    if (i + 1 >= max_count) {
+      is_live = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SequenceVoter::vote_person(bool has_mask, SZ_UINT32 &face_id, int &count,
+                                SZ_FLOAT &max_score,
+                                SZ_FLOAT &sum_score) const {
+  int max_count = 0;
+  for (size_t i = 0; i < candidate_size_; i++) {
+    if (candidates_[i].count[has_mask] > max_count)
+      max_count = candidates_[i].count[has_mask];
+  }
+  if (max_count == 0) return false;
+
+  // Among the ids with max_count frames, the winner is the first one to
+  // reach it scanning from the newest frame, i.e. the one whose oldest frame
+  // is the newest
+  size_t oldest[CAPACITY];
+  for (size_t i = 0; i < persons_.size(); i++) {
+    auto &frame = persons_.recent(i);
+    if (frame.has_mask != has_mask) continue;
+    oldest[find_candidate(frame.face_id) - candidates_] = i;
+  }
+
+  size_t winner_oldest = CAPACITY;
+  for (size_t i = 0; i < candidate_size_; i++) {
+    if (candidates_[i].count[has_mask] != max_count) continue;
+    if (oldest[i] < winner_oldest) {
+      winner_oldest = oldest[i];
+      face_id = candidates_[i].face_id;
+    }
+  }
+
+  count = max_count;
+  max_score = 0;
+  sum_score = 0;
+  for (size_t i = 0; i < persons_.size(); i++) {
+    auto &frame = persons_.recent(i);
+    if (frame.has_mask != has_mask || frame.face_id != face_id) continue;
+    if (frame.score > max_score) max_score = frame.score;
+    sum_score += frame.score;
+  }
+  return true;
+}
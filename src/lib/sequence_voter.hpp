@@ -0,0 +1,96 @@
+#ifndef SEQUENCE_VOTER_H
+#define SEQUENCE_VOTER_H
+
+#include <cstddef>
+
+#include "quface_common.hpp"
+
+namespace suanzi {
+
+// Fixed capacity ring buffer, the newest element has index 0
+template <typename T, size_t N>
+class RingBuffer {
+ public:
+  RingBuffer() : head_(0), size_(0) {}
+
+  size_t size() const { return size_; }
+  bool full() const { return size_ == N; }
+  void clear() { head_ = size_ = 0; }
+
+  // Returns true and the evicted element when the buffer was full
+  bool push(const T &value, T &evicted) {
+    bool was_full = full();
+    if (was_full) evicted = data_[head_];
+    data_[head_] = value;
+    head_ = (head_ + 1) % N;
+    if (!was_full) size_++;
+    return was_full;
+  }
+
+  const T &recent(size_t i) const { return data_[(head_ + N - 1 - i) % N]; }
+
+ private:
+  T data_[N];
+  size_t head_;
+  size_t size_;
+};
+
+// Votes on the recognition results of one tracked face over the recent
+// frames. Histories are bounded, pushing a frame is O(1) and never allocates,
+// the votes only visit the frames needed for the decision.
+class SequenceVoter {
+ public:
+  // Frames older than this are forgotten, far above the history sizes in use
+  static constexpr size_t CAPACITY = 32;
+
+  SequenceVoter();
+
+  void clear();
+
+  void add_person(const QueryResult &person, bool has_mask);
+  void add_live(bool is_live);
+
+  size_t person_size() const { return persons_.size(); }
+  size_t live_size() const { return lives_.size(); }
+
+  // Decided when one state appears min_count times, newest frames first
+  bool vote_mask(size_t min_count, bool &has_mask) const;
+
+  // Decided live when min_count of the newest max_count frames are live,
+  // decided not live when max_count frames have been seen
+  bool vote_live(size_t min_count, size_t max_count, bool &is_live) const;
+
+  // Most frequent face id among frames with the given mask state, ties go to
+  // the id which reached the count first scanning from the newest frame.
+  // Returns false if no frame has the mask state.
+  bool vote_person(bool has_mask, SZ_UINT32 &face_id, int &count,
+                   SZ_FLOAT &max_score, SZ_FLOAT &sum_score) const;
+
+ private:
+  struct PersonFrame {
+    SZ_UINT32 face_id;
+    SZ_FLOAT score;
+    bool has_mask;
+  };
+
+  struct Candidate {
+    SZ_UINT32 face_id;
+    int count[2];  // indexed by has_mask
+  };
+
+  Candidate *find_candidate(SZ_UINT32 face_id);
+  const Candidate *find_candidate(SZ_UINT32 face_id) const;
+
+  RingBuffer<PersonFrame, CAPACITY> persons_;
+  RingBuffer<bool, CAPACITY> lives_;
+
+  // Running counts of the frames in the buffers
+  int mask_count_[2];
+  int live_count_;
+  Candidate candidates_[CAPACITY];
+  size_t candidate_size_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -0,0 +1,167 @@
+#include "startup_graph.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <quface/logger.hpp>
+
+using namespace suanzi;
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point from,
+                          std::chrono::steady_clock::time_point to) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(to - from)
+      .count();
+}
+
+void StartupGraph::add(const std::string &name,
+                       const std::vector<std::string> &deps, Step fn,
+                       bool main_thread) {
+  Node node;
+  node.name = name;
+  node.fn = fn;
+  node.main_thread = main_thread;
+  node.state = PENDING;
+
+  for (auto &dep : deps) {
+    int index = -1;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      if (nodes_[i].name == dep) index = i;
+    }
+    if (index < 0)
+      throw std::invalid_argument("Unknown startup step " + dep +
+                                  " required by " + name);
+    node.deps.push_back(index);
+  }
+
+  nodes_.push_back(node);
+}
+
+bool StartupGraph::run() {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<std::thread> workers;
+  bool ok = true;
+
+  // Runs the step without the lock, returns with the lock held
+  auto execute = [&](std::unique_lock<std::mutex> &lock, Node &node) {
+    node.state = RUNNING;
+    node.start = Clock::now();
+    lock.unlock();
+
+    State state = DONE;
+    try {
+      node.fn();
+    } catch (const std::exception &e) {
+      SZ_LOG_ERROR("Startup step {} failed: {}", node.name, e.what());
+      state = FAILED;
+    }
+
+    lock.lock();
+    node.end = Clock::now();
+    node.state = state;
+  };
+
+  start_ = Clock::now();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    bool finished = true;
+    bool progress = false;
+
+    for (auto &node : nodes_) {
+      if (node.state == RUNNING) finished = false;
+      if (node.state != PENDING) continue;
+      finished = false;
+
+      bool ready = true;
+      for (int dep : node.deps) {
+        State state = nodes_[dep].state;
+        if (state == FAILED || state == SKIPPED) {
+          node.state = SKIPPED;
+          ok = false;
+          progress = true;
+          SZ_LOG_ERROR("Startup step {} skipped, {} did not finish",
+                       node.name, nodes_[dep].name);
+          break;
+        }
+        if (state != DONE) ready = false;
+      }
+      if (node.state == SKIPPED || !ready) continue;
+
+      progress = true;
+      if (node.main_thread) {
+        // The node list is rescanned afterwards, the states may have changed
+        execute(lock, node);
+        if (node.state == FAILED) ok = false;
+        break;
+      }
+
+      Node *target = &node;
+      target->state = RUNNING;
+      workers.emplace_back([&, target]() {
+        std::unique_lock<std::mutex> worker_lock(mutex);
+        execute(worker_lock, *target);
+        if (target->state == FAILED) ok = false;
+        worker_lock.unlock();
+        cond.notify_all();
+      });
+    }
+
+    if (finished) break;
+    if (!progress) cond.wait(lock);
+  }
+  lock.unlock();
+
+  for (auto &worker : workers) worker.join();
+  end_ = Clock::now();
+
+  return ok;
+}
+
+const char *StartupGraph::state_name(State state) {
+  switch (state) {
+    case PENDING:
+      return "pending";
+    case RUNNING:
+      return "running";
+    case DONE:
+      return "done";
+    case FAILED:
+      return "failed";
+    default:
+      return "skipped";
+  }
+}
+
+void StartupGraph::report(const std::string &filename) {
+  FILE *fp = fopen(filename.c_str(), "w");
+  if (fp == nullptr) SZ_LOG_WARN("Open {} failed", filename);
+
+  for (auto &node : nodes_) {
+    int64_t start_ms = 0, duration_ms = 0;
+    if (node.state == DONE || node.state == FAILED) {
+      start_ms = elapsed_ms(start_, node.start);
+      duration_ms = elapsed_ms(node.start, node.end);
+    }
+    const char *thread = node.main_thread ? "main" : "worker";
+
+    SZ_LOG_INFO("Startup step {}: start={}ms duration={}ms thread={} {}",
+                node.name, start_ms, duration_ms, thread,
+                state_name(node.state));
+    if (fp != nullptr) {
+      fprintf(fp, "%-16s start=%6lldms duration=%6lldms thread=%-6s %s\n",
+              node.name.c_str(), (long long)start_ms, (long long)duration_ms,
+              thread, state_name(node.state));
+    }
+  }
+
+  int64_t total_ms = elapsed_ms(start_, end_);
+  SZ_LOG_INFO("Startup total={}ms", total_ms);
+  if (fp != nullptr) {
+    fprintf(fp, "total=%lldms\n", (long long)total_ms);
+    fclose(fp);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef STARTUP_GRAPH_H
+#define STARTUP_GRAPH_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace suanzi {
+
+// Dependency graph of the initialization steps at boot. A step starts as soon
+// as all of its dependencies are finished, so independent steps like loading
+// models, the face database and the audio clips run in parallel. Steps which
+// must run on the Qt main thread are run by the thread calling run()
+class StartupGraph {
+ public:
+  typedef std::function<void()> Step;
+
+  // Steps can only depend on steps added before them
+  void add(const std::string &name, const std::vector<std::string> &deps,
+           Step fn, bool main_thread = false);
+
+  // Run all steps and wait for them. If a step throws, the steps depending
+  // on it are skipped and false is returned
+  bool run();
+
+  // Log the timing of every step, and write it to filename
+  void report(const std::string &filename);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  typedef enum {
+    PENDING,
+    RUNNING,
+    DONE,
+    FAILED,
+    SKIPPED,
+  } State;
+
+  struct Node {
+    std::string name;
+    std::vector<int> deps;
+    Step fn;
+    bool main_thread;
+
+    State state;
+    Clock::time_point start;
+    Clock::time_point end;
+  };
+
+  static const char *state_name(State state);
+
+  std::vector<Node> nodes_;
+  Clock::time_point start_;
+  Clock::time_point end_;
+};
+
+}  // namespace suanzi
+
+#endif
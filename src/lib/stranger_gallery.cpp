@@ -0,0 +1,117 @@
+#include "stranger_gallery.hpp"
+
+#include <cstring>
+
+#include "feature.hpp"
+
+using namespace suanzi;
+
+constexpr size_t StrangerGallery::CAPACITY;
+constexpr size_t StrangerGallery::FEATURES_PER_STRANGER;
+constexpr int StrangerGallery::TTL_SECONDS;
+
+StrangerGallery::StrangerGallery(size_t capacity, int ttl_seconds)
+    : strangers_(capacity),
+      features_(capacity * FEATURES_PER_STRANGER * SZ_FEATURE_NUM),
+      ttl_(ttl_seconds),
+      next_id_(1) {
+  clear();
+}
+
+void StrangerGallery::clear() {
+  for (auto &it : strangers_) it.face_id = 0;
+}
+
+int StrangerGallery::find(SZ_UINT32 face_id) const {
+  for (size_t i = 0; i < strangers_.size(); i++) {
+    if (strangers_[i].face_id == face_id) return i;
+  }
+  return -1;
+}
+
+void StrangerGallery::expire(Clock::time_point now) {
+  for (auto &it : strangers_) {
+    if (it.face_id != 0 && now - it.last_seen > ttl_) it.face_id = 0;
+  }
+}
+
+void StrangerGallery::put_feature(size_t slot, const FaceFeature &feature) {
+  auto &stranger = strangers_[slot];
+  memcpy(feature_at(slot, stranger.next_feature), feature.value,
+         SZ_FEATURE_NUM * sizeof(SZ_FLOAT));
+  stranger.next_feature = (stranger.next_feature + 1) % FEATURES_PER_STRANGER;
+  if (stranger.feature_count < FEATURES_PER_STRANGER) stranger.feature_count++;
+}
+
+SZ_UINT32 StrangerGallery::query(const FaceFeature &feature, float threshold,
+                                 float &score) {
+  expire(Clock::now());
+
+  SZ_UINT32 face_id = 0;
+  score = 0;
+  for (size_t slot = 0; slot < strangers_.size(); slot++) {
+    auto &stranger = strangers_[slot];
+    if (stranger.face_id == 0) continue;
+
+    for (size_t i = 0; i < stranger.feature_count; i++) {
+      float similarity = feature_similarity(feature.value, feature_at(slot, i));
+      if (similarity >= threshold && similarity > score) {
+        score = similarity;
+        face_id = stranger.face_id;
+      }
+    }
+  }
+  return face_id;
+}
+
+void StrangerGallery::update(SZ_UINT32 face_id, const FaceFeature &feature) {
+  int slot = find(face_id);
+  if (slot < 0) return;
+
+  put_feature(slot, feature);
+  strangers_[slot].visits++;
+  strangers_[slot].last_seen = Clock::now();
+}
+
+SZ_UINT32 StrangerGallery::add(const FaceFeature &feature) {
+  auto now = Clock::now();
+  expire(now);
+
+  // Free slot, otherwise the least recently seen stranger
+  size_t slot = 0;
+  for (size_t i = 0; i < strangers_.size(); i++) {
+    if (strangers_[i].face_id == 0) {
+      slot = i;
+      break;
+    }
+    if (strangers_[i].last_seen < strangers_[slot].last_seen) slot = i;
+  }
+
+  auto &stranger = strangers_[slot];
+  stranger.face_id = next_id_++;
+  if (next_id_ == 0) next_id_ = 1;
+  stranger.last_seen = now;
+  stranger.visits = 1;
+  stranger.feature_count = 0;
+  stranger.next_feature = 0;
+  put_feature(slot, feature);
+
+  return stranger.face_id;
+}
+
+int StrangerGallery::visits(SZ_UINT32 face_id) const {
+  int slot = face_id == 0 ? -1 : find(face_id);
+  return slot < 0 ? 0 : strangers_[slot].visits;
+}
+
+bool StrangerGallery::contains(SZ_UINT32 face_id) const {
+  return face_id != 0 && find(face_id) >= 0;
+}
+
+size_t StrangerGallery::size() const {
+  size_t count = 0;
+  for (auto &it : strangers_) {
+    if (it.face_id != 0) count++;
+  }
+  return count;
+}
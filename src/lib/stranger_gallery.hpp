@@ -0,0 +1,66 @@
+#ifndef STRANGER_GALLERY_H
+#define STRANGER_GALLERY_H
+
+#include <chrono>
+#include <vector>
+
+#include "quface_common.hpp"
+
+namespace suanzi {
+
+// In-memory gallery of recently seen strangers. The capacity is fixed and
+// all memory is allocated up front, the least recently seen stranger is
+// evicted when full and strangers unseen for ttl are expired. Ids are never
+// reused, so a returning stranger keeps the id until evicted.
+class StrangerGallery {
+ public:
+  static constexpr size_t CAPACITY = 128;
+  // Features kept per stranger, newer samples replace the oldest one
+  static constexpr size_t FEATURES_PER_STRANGER = 4;
+  static constexpr int TTL_SECONDS = 3600;
+
+  StrangerGallery(size_t capacity = CAPACITY, int ttl_seconds = TTL_SECONDS);
+
+  // Best matching stranger with similarity >= threshold, 0 if none
+  SZ_UINT32 query(const FaceFeature &feature, float threshold, float &score);
+
+  // Add a sample of a known stranger and count the visit
+  void update(SZ_UINT32 face_id, const FaceFeature &feature);
+
+  // Register a new stranger and returns its id
+  SZ_UINT32 add(const FaceFeature &feature);
+
+  // Times the stranger has been seen, 0 once evicted or expired
+  int visits(SZ_UINT32 face_id) const;
+  // False once the stranger has been evicted or expired
+  bool contains(SZ_UINT32 face_id) const;
+  size_t size() const;
+  void clear();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Stranger {
+    SZ_UINT32 face_id;  // 0 if the slot is free
+    Clock::time_point last_seen;
+    int visits;
+    size_t feature_count;
+    size_t next_feature;
+  };
+
+  int find(SZ_UINT32 face_id) const;
+  void expire(Clock::time_point now);
+  void put_feature(size_t slot, const FaceFeature &feature);
+  SZ_FLOAT *feature_at(size_t slot, size_t i) {
+    return &features_[(slot * FEATURES_PER_STRANGER + i) * SZ_FEATURE_NUM];
+  }
+
+  std::vector<Stranger> strangers_;
+  std::vector<SZ_FLOAT> features_;
+  std::chrono::seconds ttl_;
+  SZ_UINT32 next_id_;
+};
+
+}  // namespace suanzi
+
+#endif
@@ -1,8 +1,18 @@
 #include "system.hpp"
 
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <net/if.h>
+#include <net/route.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
 #include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <memory>
 
 #include <nlohmann/json.hpp>
 
@@ -32,47 +42,91 @@ SZ_RETCODE System::exec(const char* cmd, std::string& result) {
   return SZ_RETCODE_OK;
 }
 
+// Interface of the default route with the lowest metric, from the kernel
+// routing table instead of running `ip route`
+static bool read_default_route(std::string& name) {
+  std::ifstream route("/proc/net/route");
+  if (!route.is_open()) return false;
+
+  // Iface Destination Gateway Flags RefCnt Use Metric Mask ...
+  std::string line;
+  std::getline(route, line);
+
+  bool found = false;
+  unsigned long min_metric = 0;
+  while (std::getline(route, line)) {
+    char iface[IF_NAMESIZE + 1];
+    unsigned long destination, gateway, flags, ref_count, use, metric, mask;
+    if (sscanf(line.c_str(), "%16s %lx %lx %lx %lu %lu %lu %lx", iface,
+               &destination, &gateway, &flags, &ref_count, &use, &metric,
+               &mask) != 8)
+      continue;
+    if (destination != 0 || mask != 0 || !(flags & RTF_UP)) continue;
+
+    if (!found || metric < min_metric) {
+      name = iface;
+      min_metric = metric;
+      found = true;
+    }
+  }
+  return found;
+}
+
+static bool read_ipv4_address(const std::string& name, std::string& ip) {
+  struct ifaddrs* addrs;
+  if (getifaddrs(&addrs) != 0) return false;
+
+  bool found = false;
+  for (struct ifaddrs* it = addrs; it != nullptr; it = it->ifa_next) {
+    if (it->ifa_addr == nullptr || it->ifa_addr->sa_family != AF_INET ||
+        name != it->ifa_name)
+      continue;
+
+    char buf[INET_ADDRSTRLEN];
+    auto addr = (struct sockaddr_in*)it->ifa_addr;
+    if (inet_ntop(AF_INET, &addr->sin_addr, buf, sizeof(buf))) {
+      ip = buf;
+      found = true;
+      break;
+    }
+  }
+  freeifaddrs(addrs);
+  return found;
+}
+
+static bool read_file(const std::string& filename, std::string& content) {
+  std::ifstream i(filename);
+  if (!i.is_open()) return false;
+
+  content.assign(std::istreambuf_iterator<char>(i),
+                 std::istreambuf_iterator<char>());
+  return true;
+}
+
 SZ_RETCODE System::get_current_network(std::string& name, std::string& ip,
                                        std::string& mac_address) {
-  std::string result;
-
   name = "none";
   ip = "none";
   mac_address = "none";
 
-  // 8.8.8.8 via 192.168.2.1 dev eth0  src 192.168.2.12
-  SZ_RETCODE ret = exec("ip route get 8.8.8.8", result);
-  if (ret != SZ_RETCODE_OK) {
-    return ret;
-  }
-
-  if (result.find("unreachable") != std::string::npos) {
-    SZ_LOG_ERROR("get_current_network failed {}", result);
+  std::string route_name;
+  if (!read_default_route(route_name)) {
+    SZ_LOG_DEBUG("get_current_network failed, no default route");
     return SZ_RETCODE_FAILED;
   }
 
-  size_t dev_idx = result.find("dev");
-  size_t src_idx = result.find("src");
-  if (dev_idx == std::string::npos || src_idx == std::string::npos) {
-    SZ_LOG_ERROR("Parse result error {}", result);
+  std::string route_ip;
+  if (!read_ipv4_address(route_name, route_ip)) {
+    SZ_LOG_DEBUG("get_current_network failed, {} has no address", route_name);
     return SZ_RETCODE_FAILED;
   }
 
-  dev_idx += 4;
-  src_idx += 4;
-
-  name = result.substr(dev_idx, src_idx - dev_idx - 6 + 1);
-  ip = result.substr(src_idx, result.length() - src_idx);
-
-  trim(name);
-  trim(ip);
+  name = route_name;
+  ip = route_ip;
 
-  char cmd[100];
-  sprintf(cmd, "cat /sys/class/net/%s/address", name.c_str());
-  ret = exec(cmd, mac_address);
-  if (ret != SZ_RETCODE_OK) {
+  if (!read_file("/sys/class/net/" + name + "/address", mac_address)) {
     SZ_LOG_ERROR("/sys/class/net/{}/address not exists", name);
-    return ret;
+    return SZ_RETCODE_FAILED;
   }
 
   trim(mac_address);
@@ -101,14 +155,20 @@ SZ_RETCODE System::get_release_version(std::string& version) {
 }
 
 SZ_RETCODE System::get_hostname(std::string& hostname) {
-  hostname = "";
-  return exec("hostname", hostname);
+  char buf[HOST_NAME_MAX + 1];
+  if (gethostname(buf, sizeof(buf)) != 0) {
+    hostname = "";
+    return SZ_RETCODE_FAILED;
+  }
+  buf[HOST_NAME_MAX] = 0;
+  hostname = buf;
+  return SZ_RETCODE_OK;
 }
 
 SZ_RETCODE System::get_serial_number(std::string& serial_number) {
-  std::string name, ip, mac;
-  System::get_current_network(name, ip, mac);
+  serial_number = "";
+  if (!read_file("/etc/serial-number", serial_number)) return SZ_RETCODE_FAILED;
 
-  serial_number = "20200602" + mac.substr(0, 2);
-  return exec("cat /etc/serial-number", serial_number);
+  trim(serial_number);
+  return SZ_RETCODE_OK;
 }
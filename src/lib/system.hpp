@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include <quface/common.hpp>
 
 namespace suanzi {
@@ -0,0 +1,305 @@
+#include "template_manager.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "config.hpp"
+#include "feature.hpp"
+
+using namespace suanzi;
+
+constexpr size_t TemplateManager::TEMPLATES_PER_PERSON;
+constexpr float TemplateManager::DIVERSITY_THRESHOLD;
+constexpr int TemplateManager::FLUSH_CHANGES;
+constexpr int TemplateManager::FLUSH_INTERVAL_SECONDS;
+constexpr SZ_UINT32 TemplateManager::FILE_MAGIC;
+constexpr SZ_UINT32 TemplateManager::FILE_VERSION;
+
+TemplateManager *TemplateManager::get_instance() {
+  static TemplateManager instance;
+  return &instance;
+}
+
+TemplateManager::TemplateManager() : sequence_(0), changes_(0), stop_(false) {
+  filename_ = Config::get_quface().db_name + ".templates";
+  load();
+
+  writer_ = std::thread([this]() { run(); });
+}
+
+TemplateManager::~TemplateManager() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (writer_.joinable()) writer_.join();
+
+  flush();
+}
+
+void TemplateManager::TemplateSet::push_back(const Template &t,
+                                             const SZ_FLOAT *feature) {
+  templates.push_back(t);
+  features.insert(features.end(), feature, feature + SZ_FEATURE_NUM);
+}
+
+void TemplateManager::TemplateSet::erase(size_t i) {
+  size_t last = templates.size() - 1;
+  if (i != last) {
+    templates[i] = templates[last];
+    memcpy(feature_at(i), feature_at(last), SZ_FEATURE_NUM * sizeof(SZ_FLOAT));
+  }
+  templates.pop_back();
+  features.resize(templates.size() * SZ_FEATURE_NUM);
+}
+
+void TemplateManager::adapt(SZ_UINT32 face_id, const FaceFeature &feature,
+                            bool has_mask) {
+  std::unique_lock<RWLock> lock(sets_lock_);
+  auto &set = sets_[has_mask];
+
+  size_t count = 0;
+  int least_useful = -1;
+  for (size_t i = 0; i < set.templates.size(); i++) {
+    auto &t = set.templates[i];
+    if (t.face_id != face_id) continue;
+
+    if (feature_similarity(feature.value, set.feature_at(i)) >
+        DIVERSITY_THRESHOLD)
+      return;
+
+    count++;
+    if (least_useful < 0 || t.hits < set.templates[least_useful].hits ||
+        (t.hits == set.templates[least_useful].hits &&
+         t.last_hit < set.templates[least_useful].last_hit))
+      least_useful = i;
+  }
+
+  // A new template starts as recently used, so it is not replaced before it
+  // had a chance to match
+  Template t = {face_id, has_mask, 0, sequence_};
+  if (count < TEMPLATES_PER_PERSON) {
+    set.push_back(t, feature.value);
+  } else {
+    set.templates[least_useful] = t;
+    memcpy(set.feature_at(least_useful), feature.value,
+           SZ_FEATURE_NUM * sizeof(SZ_FLOAT));
+  }
+
+  SZ_LOG_DEBUG("Adapted template of face {}, mask={}", face_id, has_mask);
+  lock.unlock();
+  mark_dirty();
+}
+
+bool TemplateManager::query(const FaceFeature &feature, bool has_mask,
+                            SZ_UINT32 &face_id, SZ_FLOAT &score) {
+  ReadLock lock(sets_lock_);
+  auto &set = sets_[has_mask];
+
+  // Compare the dot products, only the best one is mapped to a similarity
+  int best = -1;
+  float best_dot = 0;
+  for (size_t i = 0; i < set.templates.size(); i++) {
+    float dot = feature_dot(feature.value, set.feature_at(i));
+    if (best < 0 || dot > best_dot) {
+      best = i;
+      best_dot = dot;
+    }
+  }
+  if (best < 0) return false;
+
+  face_id = set.templates[best].face_id;
+  score = best_dot / 2 + 0.5f;
+  return true;
+}
+
+void TemplateManager::hit(SZ_UINT32 face_id, const FaceFeature &feature,
+                          bool has_mask) {
+  std::unique_lock<RWLock> lock(sets_lock_);
+  auto &set = sets_[has_mask];
+
+  int best = -1;
+  float best_dot = 0;
+  for (size_t i = 0; i < set.templates.size(); i++) {
+    if (set.templates[i].face_id != face_id) continue;
+
+    float dot = feature_dot(feature.value, set.feature_at(i));
+    if (best < 0 || dot > best_dot) {
+      best = i;
+      best_dot = dot;
+    }
+  }
+  if (best < 0) return;
+
+  set.templates[best].hits++;
+  set.templates[best].last_hit = ++sequence_;
+
+  // The counts pick the template to replace, they have to survive a restart
+  lock.unlock();
+  mark_dirty();
+}
+
+void TemplateManager::remove(SZ_UINT32 face_id) {
+  std::unique_lock<RWLock> lock(sets_lock_);
+
+  bool removed = false;
+  for (auto &set : sets_) {
+    for (size_t i = set.templates.size(); i > 0; i--) {
+      if (set.templates[i - 1].face_id == face_id) {
+        set.erase(i - 1);
+        removed = true;
+      }
+    }
+  }
+
+  lock.unlock();
+  if (removed) mark_dirty();
+}
+
+void TemplateManager::clear() {
+  std::unique_lock<RWLock> lock(sets_lock_);
+  for (auto &set : sets_) {
+    set.templates.clear();
+    set.features.clear();
+  }
+
+  lock.unlock();
+  mark_dirty();
+}
+
+void TemplateManager::mark_dirty() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (++changes_ == 1 || changes_ >= FLUSH_CHANGES) cond_.notify_all();
+}
+
+void TemplateManager::load() {
+  FILE *fp = fopen(filename_.c_str(), "rb");
+  if (fp == nullptr) return;
+
+  // The count of a corrupt file is only trusted once the file is as large
+  // as it implies
+  long file_size = -1;
+  if (fseek(fp, 0, SEEK_END) == 0) file_size = ftell(fp);
+  rewind(fp);
+
+  const size_t record_size =
+      sizeof(Template) + sizeof(SZ_FLOAT) * SZ_FEATURE_NUM;
+  FileHeader header;
+  std::vector<Template> templates;
+  std::vector<SZ_FLOAT> features;
+  bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+            header.magic == FILE_MAGIC && header.version == FILE_VERSION &&
+            header.feature_num == SZ_FEATURE_NUM &&
+            file_size >= (long)sizeof(header) &&
+            (size_t)(file_size - sizeof(header)) / record_size ==
+                header.count;
+  if (ok) {
+    templates.resize(header.count);
+    features.resize(header.count * SZ_FEATURE_NUM);
+    ok = fread(templates.data(), sizeof(Template), header.count, fp) ==
+             header.count &&
+         fread(features.data(), sizeof(SZ_FLOAT) * SZ_FEATURE_NUM,
+               header.count, fp) == header.count;
+  }
+  fclose(fp);
+
+  if (!ok) {
+    SZ_LOG_WARN("Invalid template file {}, start over", filename_);
+    return;
+  }
+
+  for (size_t i = 0; i < templates.size(); i++) {
+    auto &t = templates[i];
+    sets_[t.has_mask != 0].push_back(t, &features[i * SZ_FEATURE_NUM]);
+    if (t.last_hit > sequence_) sequence_ = t.last_hit;
+  }
+  SZ_LOG_INFO("Loaded {} templates from {}", templates.size(), filename_);
+}
+
+SZ_RETCODE TemplateManager::flush() {
+  // Writes are serialized, so an older copy never replaces a newer one
+  std::unique_lock<std::mutex> write_lock(write_mutex_);
+
+  // Copy under the lock and write without it, queries go on meanwhile
+  std::vector<Template> templates;
+  std::vector<SZ_FLOAT> features;
+  int changes;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (changes_ == 0) return SZ_RETCODE_OK;
+    changes = changes_;
+    changes_ = 0;
+  }
+  {
+    ReadLock lock(sets_lock_);
+    for (auto &set : sets_) {
+      templates.insert(templates.end(), set.templates.begin(),
+                       set.templates.end());
+      features.insert(features.end(), set.features.begin(),
+                      set.features.end());
+    }
+  }
+
+  SZ_RETCODE ret = write(templates, features);
+  if (ret != SZ_RETCODE_OK) {
+    // Retry with the next batch
+    std::unique_lock<std::mutex> lock(mutex_);
+    changes_ += changes;
+    return ret;
+  }
+
+  SZ_LOG_INFO("Saved {} templates after {} changes", templates.size(),
+              changes);
+  return SZ_RETCODE_OK;
+}
+
+SZ_RETCODE TemplateManager::write(const std::vector<Template> &templates,
+                                  const std::vector<SZ_FLOAT> &features) {
+  // Write to a temporary file and rename, so a power loss never leaves a
+  // truncated file behind
+  std::string tmp_filename = filename_ + ".tmp";
+  FILE *fp = fopen(tmp_filename.c_str(), "wb");
+  if (fp == nullptr) {
+    SZ_LOG_ERROR("Open {} for write failed", tmp_filename);
+    return SZ_RETCODE_FAILED;
+  }
+
+  FileHeader header = {FILE_MAGIC, FILE_VERSION, (SZ_UINT32)templates.size(),
+                       SZ_FEATURE_NUM};
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  ok = ok && fwrite(templates.data(), sizeof(Template), templates.size(),
+                    fp) == templates.size();
+  ok = ok && fwrite(features.data(), sizeof(SZ_FLOAT), features.size(), fp) ==
+                 features.size();
+  ok = fflush(fp) == 0 && ok;
+  ok = fsync(fileno(fp)) == 0 && ok;
+  fclose(fp);
+
+  if (!ok || rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+    SZ_LOG_ERROR("Write {} failed", filename_);
+    std::remove(tmp_filename.c_str());
+    return SZ_RETCODE_FAILED;
+  }
+  return SZ_RETCODE_OK;
+}
+
+void TemplateManager::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    cond_.wait(lock, [this]() { return stop_ || changes_ > 0; });
+    if (stop_) break;
+
+    // Collect changes for a while, unless enough are pending already
+    cond_.wait_for(lock, std::chrono::seconds(FLUSH_INTERVAL_SECONDS),
+                   [this]() { return stop_ || changes_ >= FLUSH_CHANGES; });
+    if (stop_) break;
+
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef TEMPLATE_MANAGER_H
+#define TEMPLATE_MANAGER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "quface_common.hpp"
+#include "rw_lock.hpp"
+
+namespace suanzi {
+
+// Templates learned from confirmed recognitions, kept beside the registered
+// face database. Masked and unmasked faces are learned into separate sets, and
+// a face is only compared with the set of its own mask state. Every set of a
+// person has at most TEMPLATES_PER_PERSON templates, a sample too similar to
+// an existing template is skipped, and when the set is full the least used
+// template is replaced, so the query cost stays bounded
+// however long the terminal runs. Changes are written to disk in batches.
+//
+// Queries only read the set of their mask state and share a reader lock, a
+// template is credited by hit() once it supplied an accepted match.
+class TemplateManager {
+ public:
+  static constexpr size_t TEMPLATES_PER_PERSON = 4;
+  // Samples with a similarity above it add no diversity to the set
+  static constexpr float DIVERSITY_THRESHOLD = 0.95;
+  // Write after this many changes, or this long after the first one
+  static constexpr int FLUSH_CHANGES = 16;
+  static constexpr int FLUSH_INTERVAL_SECONDS = 60;
+
+  static TemplateManager *get_instance();
+
+  // Learn a confirmed sample of face_id
+  void adapt(SZ_UINT32 face_id, const FaceFeature &feature, bool has_mask);
+
+  // Best matching template of the mask state, false if there is none
+  bool query(const FaceFeature &feature, bool has_mask, SZ_UINT32 &face_id,
+             SZ_FLOAT &score);
+
+  // Credit the template of face_id which matches feature best
+  void hit(SZ_UINT32 face_id, const FaceFeature &feature, bool has_mask);
+
+  // Forget the templates of face_id, e.g. when it is removed or re-enrolled
+  void remove(SZ_UINT32 face_id);
+  void clear();
+
+  // Write the pending changes now
+  SZ_RETCODE flush();
+
+ private:
+  TemplateManager();
+  ~TemplateManager();
+
+  struct Template {
+    SZ_UINT32 face_id;
+    SZ_UINT32 has_mask;
+    // How often the template was the best match, and the query sequence
+    // number of the last time, to tell the least useful template
+    SZ_UINT32 hits;
+    SZ_UINT32 last_hit;
+  };
+
+  struct FileHeader {
+    SZ_UINT32 magic;
+    SZ_UINT32 version;
+    SZ_UINT32 count;
+    SZ_UINT32 feature_num;
+  };
+
+  static constexpr SZ_UINT32 FILE_MAGIC = 0x4c505446;  // "FTPL"
+  static constexpr SZ_UINT32 FILE_VERSION = 1;
+
+  struct TemplateSet {
+    std::vector<Template> templates;
+    // Stored contiguously for the linear scan in query
+    std::vector<SZ_FLOAT> features;
+
+    SZ_FLOAT *feature_at(size_t i) { return &features[i * SZ_FEATURE_NUM]; }
+    void push_back(const Template &t, const SZ_FLOAT *feature);
+    void erase(size_t i);
+  };
+
+  void mark_dirty();
+
+  void load();
+  SZ_RETCODE write(const std::vector<Template> &templates,
+                   const std::vector<SZ_FLOAT> &features);
+  void run();
+
+  // Indexed by has_mask
+  TemplateSet sets_[2];
+  SZ_UINT32 sequence_;
+  RWLock sets_lock_;
+  std::string filename_;
+
+  // Guards changes_ and stop_, taken after sets_lock_ if both are needed
+  int changes_;
+  std::mutex mutex_;
+  std::mutex write_mutex_;
+  std::condition_variable cond_;
+  bool stop_;
+  std::thread writer_;
+};
+
+}  // namespace suanzi
+
+#endif
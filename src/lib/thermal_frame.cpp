@@ -0,0 +1,83 @@
+#include "thermal_frame.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace suanzi;
+
+// The rotations by 90 and 270 degrees are transposed tile by tile, so both
+// the source and the destination of a tile stay in cache
+void ThermalFrame::assign_rotated(const float *src, int width, int height,
+                                  int degrees) {
+  const int TILE = 8;
+
+  switch (degrees) {
+    case 90:
+    case 270: {
+      *this = ThermalFrame(height, width);
+      float *dst = values.data();
+      bool cw = degrees == 90;
+      for (int y0 = 0; y0 < height; y0 += TILE) {
+        for (int x0 = 0; x0 < width; x0 += TILE) {
+          int y1 = std::min(y0 + TILE, height);
+          int x1 = std::min(x0 + TILE, width);
+          for (int y = y0; y < y1; y++) {
+            const float *row = src + y * width;
+            for (int x = x0; x < x1; x++) {
+              // 90: dst(height - 1 - y, x), 270: dst(y, width - 1 - x)
+              int dx = cw ? height - 1 - y : y;
+              int dy = cw ? x : width - 1 - x;
+              dst[dy * height + dx] = row[x];
+            }
+          }
+        }
+      }
+      break;
+    }
+    case 180:
+      *this = ThermalFrame(width, height);
+      std::reverse_copy(src, src + width * height, values.begin());
+      break;
+    default:
+      *this = ThermalFrame(width, height);
+      std::copy(src, src + width * height, values.begin());
+      break;
+  }
+}
+
+ThermalStats ThermalFrame::measure(const std::vector<uint8_t> &mask, float x,
+                                   float y, float box_width,
+                                   float box_height) const {
+  // Only the cells in the box are visited. The corners are compared as they
+  // are computed, so no cell on the border is lost or added by rounding.
+  auto range = [](float lo, float hi, int size, int &begin, int &end) {
+    begin = std::min(std::max((int)std::ceil(lo * size), 0), size);
+    while (begin > 0 && (float)(begin - 1) / size >= lo) begin--;
+    while (begin < size && (float)begin / size < lo) begin++;
+    end = std::min(std::max((int)std::floor(hi * size) + 1, 0), size);
+    while (end < size && (float)end / size <= hi) end++;
+    while (end > 0 && (float)(end - 1) / size > hi) end--;
+  };
+  int col_begin, col_end, row_begin, row_end;
+  range(x, x + box_width, width, col_begin, col_end);
+  range(y, y + box_height, height, row_begin, row_end);
+
+  ThermalStats stats = {0, 0, 0.5, 0.5, 0, 0};
+  for (int r = row_begin; r < row_end; r++) {
+    const float *row = values.data() + r * width;
+    const uint8_t *mask_row = mask.data() + r * width;
+    for (int c = col_begin; c < col_end; c++) {
+      if (!mask_row[c]) continue;
+      float v = row[c];
+      stats.count++;
+      stats.sum += v;
+      stats.sum_squares += v * v;
+      if (v > stats.max_temperature) {
+        stats.max_temperature = v;
+        stats.max_x = (float)c / width;
+        stats.max_y = (float)r / height;
+      }
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,49 @@
+#ifndef THERMAL_FRAME_H
+#define THERMAL_FRAME_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QMetaType>
+
+namespace suanzi {
+
+// Statistics of the cells of a face, see ThermalFrame::measure
+struct ThermalStats {
+  int count;
+  float max_temperature;
+  // Position of the maximum in fractions of the frame, the center if none
+  float max_x, max_y;
+  double sum;
+  double sum_squares;
+};
+
+// A temperature matrix of a thermal sensor in row-major order, which keeps
+// its geometry so consumers work with any sensor resolution
+struct ThermalFrame {
+  int width;
+  int height;
+  std::vector<float> values;
+
+  ThermalFrame() : width(0), height(0) {}
+  ThermalFrame(int w, int h) : width(w), height(h), values(w * h) {}
+
+  float at(int x, int y) const { return values[y * width + x]; }
+  bool empty() const { return values.empty(); }
+
+  // Copies the width x height matrix src rotated clockwise by degrees, one
+  // of 0, 90, 180 and 270. The width and height are swapped by 90 and 270.
+  void assign_rotated(const float *src, int width, int height, int degrees);
+
+  // One pass over the cells whose corner is inside the box, given in
+  // fractions of the frame, and whose mask value is set. The mask has the
+  // size of the frame.
+  ThermalStats measure(const std::vector<uint8_t> &mask, float x, float y,
+                       float box_width, float box_height) const;
+};
+
+}  // namespace suanzi
+
+Q_DECLARE_METATYPE(suanzi::ThermalFrame);
+
+#endif
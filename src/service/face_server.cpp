@@ -1,29 +1,67 @@
 #include "face_server.hpp"
 
+#include <quface/logger.hpp>
+
 using namespace suanzi;
 
+constexpr size_t FaceServer::MAX_PENDING_REQUESTS;
+
+void FaceServer::submit(ThreadPool::Priority priority,
+                        std::function<json()> request, ResultCallback cb) {
+  // The answer is given from the worker, the caller returns at once
+  auto task = [request, cb]() {
+    json result;
+    try {
+      result = request();
+    } catch (const std::exception &exc) {
+      SZ_LOG_ERROR("face server request failed: {}", exc.what());
+      result = {{"ok", false}, {"message", exc.what()}};
+    }
+    cb(result);
+  };
+
+  try {
+    pool_.enqueue_with_priority(priority, task);
+  } catch (const ThreadPoolFullError &exc) {
+    auto stats = pool_.stats();
+    SZ_LOG_WARN("face server busy, {} requests rejected", stats.rejected);
+    cb({{"ok", false}, {"message", "server busy, please retry later"}});
+  }
+}
+
 void FaceServer::add_event_source(EventEmitterPtr emitter) {
-  emitter->appendListener("db.add", [&](EventData &body, ResultCallback cb) {
-    cb(face_service_->db_add(body));
+  // Enrollment runs detection and extraction, queries and removals are served
+  // before it. The body is copied, the request outlives the dispatch.
+  emitter->appendListener("db.add", [this](EventData &body, ResultCallback cb) {
+    submit(ThreadPool::PRIORITY_LOW,
+           [this, body]() { return face_service_->db_add(body); }, cb);
   });
 
-  emitter->appendListener("db.add_many",
-                          [&](EventData &body, ResultCallback cb) {
-                            cb(face_service_->db_add_many(body));
-                          });
-
-  emitter->appendListener("db.remove_by_id",
-                          [&](EventData &body, ResultCallback cb) {
-                            cb(face_service_->db_remove_by_id(body));
-                          });
-
-  emitter->appendListener("db.remove_all",
-                          [&](EventData &body, ResultCallback cb) {
-                            cb(face_service_->db_remove_all(body));
-                          });
-
-  emitter->appendListener("db.get_all",
-                          [&](EventData &body, ResultCallback cb) {
-                            cb(face_service_->db_get_all(body));
-                          });
+  emitter->appendListener(
+      "db.add_many", [this](EventData &body, ResultCallback cb) {
+        submit(ThreadPool::PRIORITY_LOW,
+               [this, body]() { return face_service_->db_add_many(body); },
+               cb);
+      });
+
+  emitter->appendListener(
+      "db.remove_by_id", [this](EventData &body, ResultCallback cb) {
+        submit(ThreadPool::PRIORITY_NORMAL,
+               [this, body]() { return face_service_->db_remove_by_id(body); },
+               cb);
+      });
+
+  emitter->appendListener(
+      "db.remove_all", [this](EventData &body, ResultCallback cb) {
+        submit(ThreadPool::PRIORITY_NORMAL,
+               [this, body]() { return face_service_->db_remove_all(body); },
+               cb);
+      });
+
+  emitter->appendListener(
+      "db.get_all", [this](EventData &body, ResultCallback cb) {
+        submit(ThreadPool::PRIORITY_HIGH,
+               [this, body]() { return face_service_->db_get_all(body); },
+               cb);
+      });
 }
@@ -2,19 +2,31 @@
 
 #include "event.hpp"
 #include "face_service.hpp"
+#include "thread_pool.hpp"
 
 namespace suanzi {
 
 class FaceServer {
  public:
   typedef std::shared_ptr<FaceServer> ptr;
-  FaceServer(FaceService::ptr face_service) : face_service_(face_service) {}
+  FaceServer(FaceService::ptr face_service)
+      : face_service_(face_service),
+        pool_(1, MAX_PENDING_REQUESTS, ThreadPool::REJECT) {}
   ~FaceServer() {}
 
   void add_event_source(EventEmitterPtr emitter);
 
  private:
+  // Database requests are run one by one on the pool worker, which calls the
+  // result callback. Further requests are answered busy at once instead of
+  // piling up HTTP connections
+  static constexpr size_t MAX_PENDING_REQUESTS = 8;
+
+  void submit(ThreadPool::Priority priority, std::function<json()> request,
+              ResultCallback cb);
+
   FaceService::ptr face_service_;
+  ThreadPool pool_;
 };
 
 }  // namespace suanzi
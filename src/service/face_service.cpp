@@ -7,6 +7,9 @@
 
 #include "base64.hpp"
 #include "config.hpp"
+#include "face_journal.hpp"
+#include "model_registry.hpp"
+#include "template_manager.hpp"
 
 #define MAX_PERSON_INFO_SIZE 1024
 
@@ -41,12 +44,11 @@ FaceService::FaceService(PersonService::ptr person_service, bool store_image)
     : person_service_(person_service),
       image_store_dir_(person_service->image_store_path_),
       store_image_(store_image) {
-  auto quface = Config::get_quface();
-  face_database_ = std::make_shared<FaceDatabase>(quface.db_name);
-
-  detector_ = std::make_shared<FaceDetector>(quface.model_file_path);
-  extractor_ = std::make_shared<FaceExtractor>(quface.model_file_path);
-  pose_estimator_ = std::make_shared<FacePoseEstimator>(quface.model_file_path);
+  // Used from the FaceServer worker, apart from the recognition pipeline
+  auto models = ModelRegistry::get_instance();
+  detector_ = models->detector(MODEL_CONTEXT_SERVICE);
+  extractor_ = models->extractor(MODEL_CONTEXT_SERVICE);
+  pose_estimator_ = models->pose_estimator(MODEL_CONTEXT_SERVICE);
 }
 FaceService::~FaceService() {}
 
@@ -146,7 +148,7 @@ SZ_RETCODE FaceService::extract_image_feature(SZ_UINT32 face_id,
       SZ_LOG_ERROR(error_message);
       break;
     }
-    auto cfg = Config::get_detect();
+    auto &cfg = Config::get_detect();
     if (!(cfg.min_yaw <= pose.yaw && pose.yaw <= cfg.max_yaw &&
           cfg.min_pitch <= pose.pitch && pose.pitch <= cfg.max_pitch &&
           cfg.min_roll <= pose.roll && pose.roll <= cfg.max_roll)) {
@@ -246,7 +248,7 @@ json FaceService::db_add(const json &body) {
   try {
     SZ_LOG_INFO("start db_add");
     SZ_UINT32 db_size;
-    face_database_->size(db_size);
+    FaceJournal::get_instance()->size(db_size);
     if (db_size >= MAX_DATABASE_SIZE) {
       return {
           {"ok", false},
@@ -283,7 +285,7 @@ json FaceService::db_add(const json &body) {
       };
     }
 
-    ret = face_database_->add(face.id, feature);
+    ret = FaceJournal::get_instance()->add(face.id, feature);
     if (ret != SZ_RETCODE_OK) {
       SZ_LOG_ERROR("face_database_->add failed");
       return {
@@ -292,6 +294,8 @@ json FaceService::db_add(const json &body) {
           {"code", "DB_FAILED"},
       };
     }
+    // Templates learned from the previous face of the id are stale
+    TemplateManager::get_instance()->remove(face.id);
 
     ret = person_service_->update_person_face_image(face.id, buffer);
     if (ret != SZ_RETCODE_OK) {
@@ -303,16 +307,6 @@ json FaceService::db_add(const json &body) {
       };
     }
 
-    ret = face_database_->save();
-    if (ret != SZ_RETCODE_OK) {
-      SZ_LOG_ERROR("face_database_->save failed");
-      return {
-          {"ok", false},
-          {"message", "face_database_->save failed"},
-          {"code", "DB_FAILED"},
-      };
-    }
-
     return {{"ok", true}, {"message", "ok"}};
   } catch (std::exception &e) {
     SZ_LOG_ERROR("received data error {}", e.what());
@@ -338,7 +332,7 @@ json FaceService::db_add_many(const json &body) {
 
     for (auto &face : faceArrary) {
       SZ_UINT32 db_size;
-      face_database_->size(db_size);
+      FaceJournal::get_instance()->size(db_size);
       if (db_size >= MAX_DATABASE_SIZE) {
         return {
             {"ok", false},
@@ -369,7 +363,7 @@ json FaceService::db_add_many(const json &body) {
         continue;
       }
 
-      ret = face_database_->add(face.id, feature);
+      ret = FaceJournal::get_instance()->add(face.id, feature);
       if (ret != SZ_RETCODE_OK) {
         failedPersons.push_back(
             json({{"id", face.id}, {"reason", "DB_FAILED"}}));
@@ -377,6 +371,7 @@ json FaceService::db_add_many(const json &body) {
                     "DB_FAILED");
         continue;
       }
+      TemplateManager::get_instance()->remove(face.id);
 
       ret = person_service_->update_person_face_image(face.id, buffer);
       if (ret != SZ_RETCODE_OK) {
@@ -388,16 +383,6 @@ json FaceService::db_add_many(const json &body) {
       }
     }
 
-    ret = face_database_->save();
-    if (ret != SZ_RETCODE_OK) {
-      SZ_LOG_ERROR("[Add many] db.save failed");
-      return {
-          {"ok", false},
-          {"message", "db save failed"},
-          {"code", "DB_FAILED"},
-      };
-    }
-
     SZ_LOG_INFO("[Add many] success {} faces, failed {} faces",
                 faceArrary.size() - failedPersons.size(), failedPersons.size());
 
@@ -420,7 +405,8 @@ json FaceService::db_add_many(const json &body) {
 json FaceService::db_remove_by_id(const json &body) {
   SZ_LOG_DEBUG("db.remove_by_id");
   auto face_id = body["id"].get<int>();
-  SZ_RETCODE ret = face_database_->remove(face_id);
+  SZ_RETCODE ret = FaceJournal::get_instance()->remove(face_id);
+  TemplateManager::get_instance()->remove(face_id);
   if (ret != SZ_RETCODE_OK) {
     SZ_LOG_ERROR("face_database_->remove failed!");
     return {
@@ -430,22 +416,13 @@ json FaceService::db_remove_by_id(const json &body) {
     };
   }
 
-  ret = face_database_->save();
-  if (ret != SZ_RETCODE_OK) {
-    SZ_LOG_ERROR("db.save failed");
-    return {
-        {"ok", false},
-        {"message", "db save failed"},
-        {"code", "DB_FAILED"},
-    };
-  }
-
   return {{"ok", true}, {"message", "ok"}};
 }
 
 json FaceService::db_remove_all(const json &body) {
   SZ_LOG_DEBUG("db.remove_all");
-  SZ_RETCODE ret = face_database_->clear();
+  SZ_RETCODE ret = FaceJournal::get_instance()->clear();
+  TemplateManager::get_instance()->clear();
   if (ret != SZ_RETCODE_OK) {
     SZ_LOG_ERROR("db.clear failed");
     return {
@@ -455,16 +432,6 @@ json FaceService::db_remove_all(const json &body) {
     };
   }
 
-  ret = face_database_->save();
-  if (ret != SZ_RETCODE_OK) {
-    SZ_LOG_ERROR("db.save failed");
-    return {
-        {"ok", false},
-        {"message", "db save failed"},
-        {"code", "DB_FAILED"},
-    };
-  }
-
   return {{"ok", true}, {"message", "ok"}};
 }
 
@@ -489,7 +456,7 @@ json FaceService::db_get_all(const json &body) {
 
   SZ_LOG_DEBUG("db.get_all");
   std::vector<SZ_UINT32> personIDList;
-  SZ_RETCODE ret = face_database_->list(personIDList);
+  SZ_RETCODE ret = FaceJournal::get_instance()->list(personIDList);
   if (ret != SZ_RETCODE_OK) {
     SZ_LOG_ERROR("face_database_->list failed!");
     return {
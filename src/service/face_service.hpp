@@ -46,7 +46,6 @@ class FaceService {
                                    std::string &error_message);
   SZ_RETCODE read_image_as_base64(SZ_UINT32 id, std::string &result);
 
-  FaceDatabasePtr face_database_;
   FaceDetectorPtr detector_;
   FacePoseEstimatorPtr pose_estimator_;
   FaceExtractorPtr extractor_;
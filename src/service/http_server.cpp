@@ -1,6 +1,9 @@
 #include "http_server.hpp"
 
+#include <chrono>
 #include <cstdio>
+#include <future>
+#include <memory>
 #include <quface-io/engine.hpp>
 
 #include "audio_task.hpp"
@@ -10,6 +13,8 @@
 using namespace suanzi;
 using namespace suanzi::io;
 
+constexpr int HTTPServer::REQUEST_TIMEOUT_S;
+
 HTTPServer::HTTPServer(bool enable_logger) {
   server_ = std::make_shared<Server>();
 
@@ -26,6 +31,24 @@ HTTPServer::HTTPServer(bool enable_logger) {
     snprintf(buf, sizeof(buf), fmt, res.status);
     res.set_content(buf, "text/html");
   });
+
+  auto cfg = Config::get_instance();
+  cfg->appendListener("app", [](const ConfigChange& change) {
+    if (change.prev->data.app.show_infrared_window !=
+        change.cur->data.app.show_infrared_window) {
+      if (!Engine::instance()->switch_secondary_window()) {
+        SZ_LOG_ERROR("Switch secondary window failed");
+      }
+    }
+  });
+
+  cfg->appendListener("user", [](const ConfigChange& change) {
+    if (change.prev->data.user.wdr != change.cur->data.user.wdr) {
+      if (!Engine::instance()->switch_wdr_mode()) {
+        SZ_LOG_ERROR("Switch WDR mode failed");
+      }
+    }
+  });
 }
 
 void HTTPServer::response_failed(Response& res, const std::string& message) {
@@ -66,14 +89,36 @@ void HTTPServer::run(uint16_t port, const std::string& host) {
       return;
     }
 
+    // The listeners may answer later from their own thread, the response is
+    // only sent once they have
+    auto answer = std::make_shared<std::promise<json>>();
+    auto result = answer->get_future();
     try {
-      dispatch(method, body, [&](EmitCallbackData data) {
-        res.set_content(data.dump(), "application/json");
-      });
+      dispatch(method, body,
+               [answer](EmitCallbackData data) { answer->set_value(data); });
     } catch (const std::exception& exc) {
       SZ_LOG_ERROR("Message err: {}", exc.what());
+      return;
+    }
+
+    // A listener answering later keeps a copy of the callback, and with it
+    // the promise. Without one nobody is going to answer.
+    if (answer.use_count() == 1 &&
+        result.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      SZ_LOG_WARN("{} has no listener", method);
+      response_failed(res, "unknown method");
+      return;
     }
 
+    if (result.wait_for(std::chrono::seconds(REQUEST_TIMEOUT_S)) !=
+        std::future_status::ready) {
+      SZ_LOG_WARN("{} not answered in {}s", method, REQUEST_TIMEOUT_S);
+      response_failed(res, "request timeout");
+      return;
+    }
+    res.set_content(result.get().dump(), "application/json");
+
     // res.set_content("Hello World!", "application/json");
   };
 
@@ -93,37 +138,12 @@ void HTTPServer::run(uint16_t port, const std::string& host) {
       auto cfg = Config::get_instance();
       SZ_RETCODE ret;
       auto j = json::parse(req.body);
-      ret = cfg->save_diff(j);
-      // cfg->dispatch("led diff");
+      ret = cfg->apply_patch(j);
       if (ret != SZ_RETCODE_OK) {
         response_failed(res, "save error " + std::to_string(ret));
         return;
       }
 
-      auto pre_user = Config::get_user();
-      auto pre_app = Config::get_app();
-
-      ret = cfg->reload();
-      if (ret != SZ_RETCODE_OK) {
-        response_failed(res, "reload error " + std::to_string(ret));
-        return;
-      }
-
-      auto post_user = Config::get_user();
-      auto post_app = Config::get_app();
-
-      if (pre_app.show_infrared_window != post_app.show_infrared_window) {
-        if (!Engine::instance()->switch_secondary_window()) {
-          SZ_LOG_ERROR("Switch secondary window failed");
-        }
-      }
-
-      if (pre_user.wdr != post_user.wdr) {
-        if (!Engine::instance()->switch_wdr_mode()) {
-          SZ_LOG_ERROR("Switch WDR mode failed");
-        }
-      }
-
       response_ok(res);
     } catch (const std::exception& exc) {
       SZ_LOG_ERROR("Message err: {}", exc.what());
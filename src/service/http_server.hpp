@@ -20,6 +20,10 @@ class HTTPServer : public EventEmitter {
   void run(uint16_t port, const std::string& host = "0.0.0.0");
 
  private:
+  // Longest wait for the answer of a db request, enrollment of a batch
+  // included
+  static constexpr int REQUEST_TIMEOUT_S = 60;
+
   void response_failed(Response& res, const std::string& message);
   void response_ok(Response& res);
 
@@ -36,7 +36,7 @@ struct PersonData {
 
   cv::Mat bgr_snapshot;
   cv::Mat nir_snapshot;
-  cv::Mat face_snapshot;
+  cv::Mat face_snapshot;  // RGB
 
   bool is_duplicated;
   bool has_mask;
@@ -1,78 +1,253 @@
 #ifndef THREAD_POOL_H
 #define THREAD_POOL_H
 
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+namespace suanzi {
+
+class ThreadPoolFullError : public std::runtime_error {
+ public:
+  ThreadPoolFullError() : std::runtime_error("ThreadPool queue is full") {}
+};
+
 class ThreadPool {
  public:
-  ThreadPool(size_t);
-  template <class F, class... Args>
-  void enqueue(F&& f, Args&&... args);
+  // What enqueue does when the queue already holds max_queue_size tasks
+  typedef enum {
+    BLOCK,        // wait until a worker takes a task
+    REJECT,       // throw ThreadPoolFullError
+    DROP_OLDEST,  // drop the oldest task of the lowest priority below the
+                  // new one, or the new one if there is none. The future of
+                  // the dropped task gets a broken_promise error.
+  } OverflowPolicy;
+
+  typedef enum {
+    PRIORITY_LOW = 0,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+    PRIORITY_COUNT,
+  } Priority;
+
+  struct Stats {
+    size_t submitted;
+    size_t completed;
+    size_t rejected;
+    size_t dropped;
+    // time spent in queue and running, microseconds
+    uint64_t total_wait_us;
+    uint64_t max_wait_us;
+    uint64_t total_run_us;
+    uint64_t max_run_us;
+  };
+
+  // max_queue_size = 0 means unbounded
+  ThreadPool(size_t threads, size_t max_queue_size = 0,
+             OverflowPolicy policy = BLOCK);
   ~ThreadPool();
 
+  template <class F, class... Args>
+  auto enqueue(F &&f, Args &&... args)
+      -> std::future<typename std::result_of<F(Args...)>::type>;
+
+  template <class F, class... Args>
+  auto enqueue_with_priority(Priority priority, F &&f, Args &&... args)
+      -> std::future<typename std::result_of<F(Args...)>::type>;
+
+  // Stop accepting tasks and join the workers. With drain, the queued tasks
+  // are run first, otherwise they are dropped
+  void shutdown(bool drain = true);
+
+  size_t queue_size();
+  Stats stats();
+
  private:
-  // need to keep track of threads so we can join them
-  std::vector<std::thread> workers;
-  // the task queue
-  std::queue<std::function<void()> > tasks;
-
-  // synchronization
-  std::mutex queue_mutex;
-  std::condition_variable condition;
-  bool stop;
+  typedef std::chrono::steady_clock Clock;
+
+  struct Task {
+    std::function<void()> fn;
+    Clock::time_point enqueue_time;
+  };
+
+  void worker();
+  bool push(Priority priority, std::function<void()> fn);
+
+  static uint64_t elapsed_us(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+        .count();
+  }
+
+  std::vector<std::thread> workers_;
+  // one FIFO per priority
+  std::deque<Task> queues_[PRIORITY_COUNT];
+  size_t queue_size_;
+  size_t max_queue_size_;
+  OverflowPolicy policy_;
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  bool stop_;
+  bool drain_;
+
+  Stats stats_;
 };
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
+inline ThreadPool::ThreadPool(size_t threads, size_t max_queue_size,
+                              OverflowPolicy policy)
+    : queue_size_(0),
+      max_queue_size_(max_queue_size),
+      policy_(policy),
+      stop_(false),
+      drain_(true),
+      stats_() {
   for (size_t i = 0; i < threads; ++i)
-    workers.emplace_back([this] {
-      for (;;) {
-        std::function<void()> task;
-
-        {
-          std::unique_lock<std::mutex> lock(this->queue_mutex);
-          this->condition.wait(
-              lock, [this] { return this->stop || !this->tasks.empty(); });
-          if (this->stop && this->tasks.empty()) return;
-          task = std::move(this->tasks.front());
-          this->tasks.pop();
-        }
+    workers_.emplace_back(&ThreadPool::worker, this);
+}
+
+inline ThreadPool::~ThreadPool() { shutdown(true); }
+
+inline void ThreadPool::worker() {
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this] { return stop_ || queue_size_ > 0; });
+      if (stop_ && (queue_size_ == 0 || !drain_)) return;
 
-        task();
+      for (int p = PRIORITY_COUNT - 1; p >= 0; p--) {
+        if (!queues_[p].empty()) {
+          task = std::move(queues_[p].front());
+          queues_[p].pop_front();
+          break;
+        }
       }
-    });
+      queue_size_--;
+    }
+    not_full_.notify_one();
+
+    auto start = Clock::now();
+    task.fn();
+    auto end = Clock::now();
+
+    uint64_t wait_us = elapsed_us(task.enqueue_time, start);
+    uint64_t run_us = elapsed_us(start, end);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stats_.completed++;
+      stats_.total_wait_us += wait_us;
+      stats_.total_run_us += run_us;
+      if (wait_us > stats_.max_wait_us) stats_.max_wait_us = wait_us;
+      if (run_us > stats_.max_run_us) stats_.max_run_us = run_us;
+    }
+  }
 }
 
-// add new work item to the pool
-template <class F, class... Args>
-void ThreadPool::enqueue(F&& f, Args&&... args) {
-  auto task = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+inline bool ThreadPool::push(Priority priority, std::function<void()> fn) {
+  Task dropped;
   {
-    std::unique_lock<std::mutex> lock(queue_mutex);
+    std::unique_lock<std::mutex> lock(mutex_);
 
     // don't allow enqueueing after stopping the pool
-    if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+    if (stop_) throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    if (max_queue_size_ > 0 && queue_size_ >= max_queue_size_) {
+      if (policy_ == REJECT) {
+        stats_.rejected++;
+        return false;
+      } else if (policy_ == BLOCK) {
+        not_full_.wait(lock, [this] {
+          return stop_ || queue_size_ < max_queue_size_;
+        });
+        if (stop_) throw std::runtime_error("enqueue on stopped ThreadPool");
+      } else {
+        // destroyed outside of the lock
+        stats_.dropped++;
+        int p = 0;
+        while (p < priority && queues_[p].empty()) p++;
+        if (p == priority) {
+          dropped.fn = std::move(fn);
+          return true;
+        }
+        dropped = std::move(queues_[p].front());
+        queues_[p].pop_front();
+        queue_size_--;
+      }
+    }
 
-    tasks.emplace([task]() { task(); });
+    queues_[priority].push_back(Task{std::move(fn), Clock::now()});
+    queue_size_++;
+    stats_.submitted++;
   }
-  condition.notify_one();
+  not_empty_.notify_one();
+  return true;
+}
+
+template <class F, class... Args>
+auto ThreadPool::enqueue(F &&f, Args &&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type> {
+  return enqueue_with_priority(PRIORITY_NORMAL, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+}
+
+template <class F, class... Args>
+auto ThreadPool::enqueue_with_priority(Priority priority, F &&f,
+                                       Args &&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type> {
+  typedef typename std::result_of<F(Args...)>::type return_type;
+
+  // std::function requires a copyable target, so the packaged_task is shared
+  auto task = std::make_shared<std::packaged_task<return_type()>>(
+      std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  std::future<return_type> result = task->get_future();
+
+  if (!push(priority, [task]() { (*task)(); })) throw ThreadPoolFullError();
+
+  return result;
 }
 
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool() {
+inline void ThreadPool::shutdown(bool drain) {
+  std::deque<Task> dropped[PRIORITY_COUNT];
   {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    stop = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stop_ && workers_.empty()) return;
+    stop_ = true;
+    drain_ = drain;
+    if (!drain) {
+      for (int p = 0; p < PRIORITY_COUNT; p++) {
+        stats_.dropped += queues_[p].size();
+        dropped[p].swap(queues_[p]);
+      }
+      queue_size_ = 0;
+    }
   }
-  condition.notify_all();
-  for (std::thread& worker : workers) worker.join();
+  not_empty_.notify_all();
+  not_full_.notify_all();
+
+  for (std::thread &worker : workers_) worker.join();
+  workers_.clear();
+}
+
+inline size_t ThreadPool::queue_size() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return queue_size_;
 }
 
+inline ThreadPool::Stats ThreadPool::stats() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace suanzi
+
 #endif
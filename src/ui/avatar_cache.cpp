@@ -0,0 +1,82 @@
+#include "avatar_cache.hpp"
+
+#include <sys/stat.h>
+
+#include <QImageReader>
+
+#include <quface/logger.hpp>
+
+#include "task_executor.hpp"
+
+using namespace suanzi;
+
+constexpr size_t AvatarCache::CAPACITY;
+
+AvatarCache *AvatarCache::get_instance() {
+  static AvatarCache instance;
+  return &instance;
+}
+
+AvatarCache::AvatarCache(QObject *parent) {
+  TaskExecutor::get_instance()->attach(this, LANE_BACKGROUND);
+}
+
+std::string AvatarCache::make_key(const std::string &path, const QSize &size) {
+  // Qt resources never change
+  long mtime = 0;
+  struct stat st;
+  if (path[0] != ':' && stat(path.c_str(), &st) == 0) mtime = st.st_mtime;
+
+  return path + "@" + std::to_string(mtime) + "@" +
+         std::to_string(size.width()) + "x" + std::to_string(size.height());
+}
+
+QImage AvatarCache::get(const std::string &path, const QSize &size) {
+  if (path.empty()) return QImage();
+
+  std::string key = make_key(path, size);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->image;
+    }
+    if (!loading_.insert(key).second) return QImage();
+  }
+
+  QMetaObject::invokeMethod(this, "rx_load", Qt::QueuedConnection,
+                            Q_ARG(QString, QString::fromStdString(path)),
+                            Q_ARG(QSize, size),
+                            Q_ARG(QString, QString::fromStdString(key)));
+  return QImage();
+}
+
+void AvatarCache::rx_load(QString path, QSize size, QString key) {
+  // JPEG avatars are decoded at the reduced size directly
+  QImageReader reader(path);
+  reader.setScaledSize(size);
+  QImage image = reader.read();
+  if (image.isNull()) {
+    SZ_LOG_WARN("Load avatar {} failed: {}", path.toStdString(),
+                reader.errorString().toStdString());
+  } else {
+    image = image.convertToFormat(QImage::Format_RGB888);
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::string k = key.toStdString();
+    loading_.erase(k);
+
+    // A failed load is cached too, so a broken file is not read again
+    entries_.push_front({k, image});
+    index_[k] = entries_.begin();
+    if (entries_.size() > CAPACITY) {
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+
+  emit tx_loaded(path);
+}
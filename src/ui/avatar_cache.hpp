@@ -0,0 +1,57 @@
+#ifndef AVATAR_CACHE_H
+#define AVATAR_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <QImage>
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+namespace suanzi {
+
+// Decoded avatars, scaled to the size they are displayed at. Decoding runs on
+// a background thread, so a miss never blocks the GUI: get() returns a null
+// image and tx_loaded is emitted once the avatar is ready. Entries are keyed
+// by the file modification time as well, so a replaced avatar is reloaded.
+class AvatarCache : public QObject {
+  Q_OBJECT
+
+ public:
+  static constexpr size_t CAPACITY = 32;
+
+  static AvatarCache *get_instance();
+
+  // Can only be called from the GUI thread
+  QImage get(const std::string &path, const QSize &size);
+
+ signals:
+  void tx_loaded(QString path);
+
+ private slots:
+  void rx_load(QString path, QSize size, QString key);
+
+ private:
+  AvatarCache(QObject *parent = nullptr);
+
+  struct Entry {
+    std::string key;
+    QImage image;
+  };
+
+  static std::string make_key(const std::string &path, const QSize &size);
+
+  std::mutex mutex_;
+  // Most recently used first
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  std::set<std::string> loading_;
+};
+
+}  // namespace suanzi
+
+#endif
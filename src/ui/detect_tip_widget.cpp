@@ -6,6 +6,8 @@
 #include <QTimer>
 
 #include "config.hpp"
+#include "geometry.hpp"
+#include "overlay_compositor.hpp"
 
 using namespace suanzi;
 
@@ -17,6 +19,7 @@ DetectTipWidget::DetectTipWidget(int win_x, int win_y, int win_width,
       win_height_(win_height),
       lost_age_(0),
       is_valid_(false),
+      has_box_(false),
       QWidget(parent) {
   detect_pos_x_ = 0.0;
   detect_pos_y_ = 0.0;
@@ -27,19 +30,44 @@ DetectTipWidget::DetectTipWidget(int win_x, int win_y, int win_width,
   palette.setColor(QPalette::Background, Qt::transparent);
   setPalette(palette);
 
-  // move(win_x_, win_y_);
-  // setFixedSize(win_width_, win_height_);
-  setGeometry(detect_pos_x_ + win_x_, detect_pos_y_ + win_y_, detect_width_,
-              detect_height_);
+  // The widget covers the whole window and never moves, the box is painted
+  // in place and only its old and new areas are repainted
+  setAttribute(Qt::WA_TransparentForMouseEvents, true);
+  setGeometry(win_x_, win_y_, win_width_, win_height_);
 }
 
 DetectTipWidget::~DetectTipWidget() {}
 
 void DetectTipWidget::paintEvent(QPaintEvent *event) {
+  OverlayCompositor::PaintTimer timer("detect_tip");
   QPainter painter(this);
   paint(&painter);
 }
 
+QRect DetectTipWidget::box_rect() {
+  if (!has_box_) return QRect();
+
+  // Including the half of the pen outside of the box
+  const int margin = PEN_WIDTH / 2 + 1;
+  return QRect(detect_pos_x_, detect_pos_y_, detect_width_, detect_height_)
+      .adjusted(-margin, -margin, margin, margin);
+}
+
+void DetectTipWidget::set_box(bool has_box) {
+  QRect old_rect = box_rect();
+  has_box_ = has_box;
+  QRect new_rect = box_rect();
+
+#ifdef DEBUG
+  // The debug pose and landmarks are drawn outside of the box
+  OverlayCompositor::get_instance()->invalidate(this, rect());
+#else
+  auto compositor = OverlayCompositor::get_instance();
+  compositor->invalidate(this, old_rect);
+  compositor->invalidate(this, new_rect);
+#endif
+}
+
 void DetectTipWidget::get_detect_position(float &x, float &y, float &width,
                                           float &height) {
   if (rects_.size() > 0) {
@@ -50,11 +78,11 @@ void DetectTipWidget::get_detect_position(float &x, float &y, float &width,
     do {
       it -= 1;
 
-      QRect inter_section = latest.intersected(*it);
-      QRect united_section = latest.united(*it);
-
-      float iou = 1.f * inter_section.width() * inter_section.height() /
-                  united_section.width() / united_section.height();
+      float iou = geometry::intersection_over_hull(
+          {(float)latest.x(), (float)latest.y(), (float)latest.width(),
+           (float)latest.height()},
+          {(float)it->x(), (float)it->y(), (float)it->width(),
+           (float)it->height()});
 
       float weight = pow(iou, 6);
 
@@ -75,18 +103,18 @@ void DetectTipWidget::get_detect_position(float &x, float &y, float &width,
 
 void DetectTipWidget::paint(QPainter *painter) {
   // if (rects_.size() > 0 && !Config::get_user().enable_temperature) {
-  if (rects_.size() > 0) {
+  if (has_box_ && rects_.size() > 0) {
     float width = detect_width_;
     float height = detect_height_;
-    float top_x = 1.0;
-    float top_y = 1.0;
+    float top_x = detect_pos_x_ + 1.0;
+    float top_y = detect_pos_y_ + 1.0;
     float bottom_x = top_x + width - 2.0;
     float bottom_y = top_y + height - 2.0;
 
     if (is_valid_)
-      painter->setPen(QPen(QColor(0, 0, 255, 128), 5));
+      painter->setPen(QPen(QColor(0, 0, 255, 128), PEN_WIDTH));
     else
-      painter->setPen(QPen(QColor(255, 0, 0, 128), 5));
+      painter->setPen(QPen(QColor(255, 0, 0, 128), PEN_WIDTH));
     painter->drawLine(top_x, top_y, top_x + width / 5, top_y);
     painter->drawLine(top_x, top_y, top_x, top_y + height / 5);
     painter->drawLine(top_x, bottom_y, top_x + width / 5, bottom_y);
@@ -110,9 +138,11 @@ void DetectTipWidget::paint(QPainter *painter) {
 void DetectTipWidget::rx_display(DetectionRatio detection, bool to_clear,
                                  bool valid, bool is_bgr) {
   if (Config::get_user().enable_temperature) {
+    if (has_box_) set_box(false);
     hide();
     return;
   }
+  if (isHidden()) show();
 
   int box_x = 1;
   int box_y = 1;
@@ -156,17 +186,17 @@ void DetectTipWidget::rx_display(DetectionRatio detection, bool to_clear,
 
     if (is_bgr) is_valid_ = valid;
 
+    // The old box area is invalidated before moving
+    if (has_box_) set_box(false);
     get_detect_position(detect_pos_x_, detect_pos_y_, detect_width_,
                         detect_height_);
-    setGeometry(detect_pos_x_ + win_x_, detect_pos_y_ + win_y_, detect_width_,
-                detect_height_);
-    show();
+    set_box(true);
   } else {
     if (++lost_age_ > MAX_LOST_AGE) {
       rects_.clear();
       lost_age_ = 0;
       is_valid_ = false;
     }
-    hide();
+    if (has_box_) set_box(false);
   }
 }
@@ -32,6 +32,10 @@ class DetectTipWidget : public QWidget {
  private:
   void get_detect_position(float &x, float &y, float &width, float &height);
 
+  // Area painted for the current box, empty if there is no box
+  QRect box_rect();
+  void set_box(bool has_box);
+
  private:
   class InternalEventLoopThread : public QThread {
    public:
@@ -44,6 +48,7 @@ class DetectTipWidget : public QWidget {
  private:
   static constexpr int MAX_RECT_COUNT = 10;
   static constexpr int MAX_LOST_AGE = 5;
+  static constexpr int PEN_WIDTH = 5;
 
   std::vector<QRect> rects_;
   QPolygon landmarks_;
@@ -57,6 +62,7 @@ class DetectTipWidget : public QWidget {
   int lost_age_;
 
   bool is_valid_;
+  bool has_box_;
 
   float detect_pos_x_;
   float detect_pos_y_;
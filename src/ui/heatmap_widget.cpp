@@ -6,12 +6,86 @@
 #include <QPaintEvent>
 
 #include "config.hpp"
+#include "overlay_compositor.hpp"
 
 using namespace suanzi;
-using namespace suanzi::io;
+
+constexpr int HeatmapRenderer::PALETTE_SIZE;
+
+HeatmapRenderer::HeatmapRenderer()
+    : src_width_(0), src_height_(0), dst_width_(0), dst_height_(0) {
+  // Green for the coldest, through yellow, to red for the hottest
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    float ratio = 2.f * i / (PALETTE_SIZE - 1);
+    int r = std::min(1.f, ratio) * 255;
+    int g = std::min(1.f, 2 - ratio) * 255;
+    palette_[i] = qRgb(r, g, 0);
+  }
+}
+
+void HeatmapRenderer::resize(int src_width, int src_height, int dst_width,
+                             int dst_height) {
+  src_width_ = src_width;
+  src_height_ = src_height;
+  dst_width_ = dst_width;
+  dst_height_ = dst_height;
+
+  // Pixel centers of the image mapped to the frame, clamped at the borders
+  auto sample = [](int src, int dst, std::vector<int> &i0,
+                   std::vector<int> &i1, std::vector<float> &f) {
+    i0.resize(dst);
+    i1.resize(dst);
+    f.resize(dst);
+    float scale = (float)src / dst;
+    for (int i = 0; i < dst; i++) {
+      float s = std::max(0.f, (i + 0.5f) * scale - 0.5f);
+      int s0 = std::min((int)s, src - 1);
+      i0[i] = s0;
+      i1[i] = std::min(s0 + 1, src - 1);
+      f[i] = std::min(s - s0, 1.f);
+    }
+  };
+  sample(src_width, dst_width, x0_, x1_, fx_);
+  sample(src_height, dst_height, y0_, y1_, fy_);
+
+  normalized_.resize(src_width * src_height);
+  row_.resize(src_width);
+}
+
+void HeatmapRenderer::render(const ThermalFrame &frame, QImage &image) {
+  if (frame.empty() || image.isNull()) return;
+
+  if (frame.width != src_width_ || frame.height != src_height_ ||
+      image.width() != dst_width_ || image.height() != dst_height_)
+    resize(frame.width, frame.height, image.width(), image.height());
+
+  const float *values = frame.values.data();
+  const size_t size = frame.values.size();
+  auto range = std::minmax_element(values, values + size);
+  float min = *range.first, max = *range.second;
+
+  // Normalized to palette indices, so interpolation needs no more scaling
+  float scale = max > min ? (PALETTE_SIZE - 1) / (max - min) : 0;
+  float *normalized = normalized_.data();
+  for (size_t i = 0; i < size; i++) normalized[i] = (values[i] - min) * scale;
+
+  float *row = row_.data();
+  for (int y = 0; y < dst_height_; y++) {
+    const float *r0 = normalized + y0_[y] * src_width_;
+    const float *r1 = normalized + y1_[y] * src_width_;
+    const float fy = fy_[y];
+    for (int x = 0; x < src_width_; x++) row[x] = r0[x] + fy * (r1[x] - r0[x]);
+
+    QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+    for (int x = 0; x < dst_width_; x++) {
+      float a = row[x0_[x]], b = row[x1_[x]];
+      line[x] = palette_[(int)(a + fx_[x] * (b - a) + 0.5f)];
+    }
+  }
+}
 
 HeatmapWidget::HeatmapWidget(int width, int height, QWidget *parent)
-    : QWidget(parent), raw_(16, 16, CV_8UC3), init_(false), success_(0) {
+    : QWidget(parent), init_(false), success_(0) {
   setAttribute(Qt::WA_StyledBackground, true);
   setAutoFillBackground(true);
 
@@ -30,61 +104,39 @@ HeatmapWidget::HeatmapWidget(int width, int height, QWidget *parent)
   detection_.width = 0.1;
   detection_.height = 0.1;
 
-  raw_ = cv::Scalar(0, 255, 0);
-  heatmap_ = QPixmap::fromImage(
-      QImage((unsigned char *)raw_.data, 16, 16, QImage::Format_RGB888));
+  heatmap_ = QImage(w, h, QImage::Format_RGB32);
+  heatmap_.fill(qRgb(0, 255, 0));
 }
 
 HeatmapWidget::~HeatmapWidget() {}
 
 void HeatmapWidget::rx_init(int success) {
   success_ = success;
-  update();
+  OverlayCompositor::get_instance()->invalidate(this, rect());
 }
 
-void HeatmapWidget::rx_update(TemperatureMatrix mat, DetectionRatio detection,
+void HeatmapWidget::rx_update(ThermalFrame frame, DetectionRatio detection,
                               float x, float y) {
-  assert(mat.size == 256);
   init_ = true;
 
-  min_ = max_ = mat.value[0];
-  for (size_t i = 1; i < 256; i++) {
-    min_ = std::min(min_, mat.value[i]);
-    max_ = std::max(max_, mat.value[i]);
-  }
-
-  for (size_t i = 0; i < 256; i++) {
-    int x = i % 16, y = i / 16;
-
-    float value = mat.value[i];
-    float ratio = 2 * (value - min_) / (max_ - min_);
-    int r = std::min(1.f, ratio) * 255;
-    int g = std::min(1.f, 2 - ratio) * 255;
-    int b = 0;
-
-    cv::Vec3b &color = raw_.at<cv::Vec3b>(y, x);
-    color[0] = r;
-    color[1] = g;
-    color[2] = b;
-    raw_.at<cv::Vec3b>(y, x) = color;
-  }
-
-  heatmap_ = QPixmap::fromImage(
-      QImage((unsigned char *)raw_.data, 16, 16, QImage::Format_RGB888));
+  renderer_.render(frame, heatmap_);
   detection_ = detection;
   x_ = x;
   y_ = y;
-  update();
+  // The whole image changes with every thermal frame
+  OverlayCompositor::get_instance()->invalidate(this, rect());
 }
 
 void HeatmapWidget::paintEvent(QPaintEvent *event) {
+  OverlayCompositor::PaintTimer timer("heatmap");
   QPainter painter(this);
   const int w = width();
   const int h = height();
 
   if (Config::get_user().enable_temperature) {
     const QRect target(0, 0, w, h);
-    painter.drawPixmap(target, heatmap_, QRect());
+    // Already rendered at the widget size
+    painter.drawImage(0, 0, heatmap_);
     painter.setPen(Qt::white);
     if (init_) {
       QRect face(target.x() + target.width() * detection_.x,
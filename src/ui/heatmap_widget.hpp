@@ -1,20 +1,45 @@
 #ifndef HEATMAP_H
 #define HEATMAP_H
 
+#include <vector>
+
 #include <QFont>
+#include <QImage>
 #include <QPainter>
-#include <QPixmap>
 #include <QWidget>
 
-#include <opencv2/opencv.hpp>
-
-#include <quface-io/temperature.hpp>
-
 #include "detection_data.hpp"
+#include "thermal_frame.hpp"
 
 namespace suanzi {
 
-using namespace io;
+// Maps a thermal frame of any resolution to colors, bilinearly upsampled to
+// the target image size. The sampling positions are computed once per frame
+// and image geometry, so an update only normalizes the values and looks up
+// the palette.
+class HeatmapRenderer {
+ public:
+  HeatmapRenderer();
+
+  // image must be Format_RGB32
+  void render(const ThermalFrame &frame, QImage &image);
+
+ private:
+  static constexpr int PALETTE_SIZE = 256;
+
+  void resize(int src_width, int src_height, int dst_width, int dst_height);
+
+  QRgb palette_[PALETTE_SIZE];
+
+  int src_width_, src_height_;
+  int dst_width_, dst_height_;
+  std::vector<int> x0_, x1_, y0_, y1_;
+  std::vector<float> fx_, fy_;
+
+  // Scratch buffers reused between updates
+  std::vector<float> normalized_;
+  std::vector<float> row_;
+};
 
 class HeatmapWidget : public QWidget {
   Q_OBJECT
@@ -28,21 +53,17 @@ class HeatmapWidget : public QWidget {
 
  private slots:
   void rx_init(int success);
-  void rx_update(TemperatureMatrix mat, DetectionRatio detection, float x,
+  void rx_update(ThermalFrame frame, DetectionRatio detection, float x,
                  float y);
 
- private:
-  QColor to_rgb(float value);
-
  private:
   QFont font_;
 
-  float min_, max_;
   float x_, y_;
 
-  cv::Mat raw_;
   bool init_;
-  QPixmap heatmap_;
+  HeatmapRenderer renderer_;
+  QImage heatmap_;
   DetectionRatio detection_;
   int success_;
 };
@@ -4,7 +4,6 @@
 
 #include <QDateTime>
 #include <QPainter>
-#include <QTimer>
 
 #include "config.hpp"
 
@@ -35,10 +34,14 @@ OutlineWidget::OutlineWidget(int width, int height, QWidget *parent)
 
   rx_update();
 
-  timer_.setInterval(1000);
-  connect((const QObject *)&timer_, SIGNAL(timeout()), (const QObject *)this,
-          SLOT(rx_update()));
-  timer_.start();
+  // Config listeners run in the thread applying the change, the style is
+  // updated in the GUI thread
+  Config::get_instance()->appendListener(
+      "user", [this](const ConfigChange &change) {
+        if (change.prev->data.user.enable_temperature !=
+            change.cur->data.user.enable_temperature)
+          QMetaObject::invokeMethod(this, "rx_update", Qt::QueuedConnection);
+      });
 }
 
 OutlineWidget::~OutlineWidget() {}
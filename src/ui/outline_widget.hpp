@@ -1,7 +1,6 @@
 #ifndef OUTLINE_WIDGET_H
 #define OUTLINE_WIDGET_H
 
-#include <QTimer>
 #include <QWidget>
 
 namespace suanzi {
@@ -18,8 +17,6 @@ class OutlineWidget : public QWidget {
   void rx_update();
 
  private:
-  QTimer timer_;
-
   QString background_style_, no_style_;
 
   bool show_valid_rect_;
@@ -0,0 +1,96 @@
+#include "overlay_compositor.hpp"
+
+#include <QEvent>
+#include <QGuiApplication>
+#include <QScreen>
+
+#include <quface/logger.hpp>
+
+using namespace suanzi;
+
+constexpr int OverlayCompositor::DEFAULT_REFRESH_RATE;
+constexpr int OverlayCompositor::REPORT_INTERVAL_MS;
+
+OverlayCompositor *OverlayCompositor::get_instance() {
+  static OverlayCompositor instance;
+  return &instance;
+}
+
+OverlayCompositor::OverlayCompositor(QObject *parent)
+    : QObject(parent), in_frame_(false), invalidations_(0), flushes_(0) {
+  qreal refresh_rate = DEFAULT_REFRESH_RATE;
+  QScreen *screen = QGuiApplication::primaryScreen();
+  if (screen && screen->refreshRate() > 0) refresh_rate = screen->refreshRate();
+
+  flush_timer_.setSingleShot(true);
+  flush_timer_.setTimerType(Qt::PreciseTimer);
+  flush_timer_.setInterval(1000 / refresh_rate);
+  connect(&flush_timer_, SIGNAL(timeout()), this, SLOT(rx_flush()));
+
+  report_timer_.setInterval(REPORT_INTERVAL_MS);
+  connect(&report_timer_, SIGNAL(timeout()), this, SLOT(rx_report()));
+  report_timer_.start();
+}
+
+void OverlayCompositor::attach(QWidget *window) {
+  window->installEventFilter(this);
+}
+
+void OverlayCompositor::invalidate(QWidget *widget, const QRect &rect) {
+  if (rect.isEmpty()) return;
+  invalidations_++;
+
+  bool found = false;
+  for (auto &it : dirty_) {
+    if (it.first == widget) {
+      it.second += rect;
+      found = true;
+      break;
+    }
+  }
+  if (!found) dirty_.emplace_back(widget, QRegion(rect));
+
+  // Started by the first change of a frame, the following ones join it
+  if (!flush_timer_.isActive()) flush_timer_.start();
+}
+
+void OverlayCompositor::rx_flush() {
+  for (auto &it : dirty_) {
+    if (it.first) it.first->update(it.second);
+  }
+  dirty_.clear();
+  flushes_++;
+}
+
+void OverlayCompositor::add_paint_time(const std::string &name, int64_t us) {
+  auto &stats = stats_[name];
+  stats.count++;
+  stats.total_us += us;
+  if (us > stats.max_us) stats.max_us = us;
+}
+
+bool OverlayCompositor::eventFilter(QObject *object, QEvent *event) {
+  if (event->type() != QEvent::UpdateRequest || in_frame_) return false;
+
+  // Qt paints all dirty widgets of the window while handling UpdateRequest,
+  // so handling it here measures the whole frame
+  in_frame_ = true;
+  PaintTimer timer("frame");
+  object->event(event);
+  in_frame_ = false;
+  return true;
+}
+
+void OverlayCompositor::rx_report() {
+  SZ_LOG_INFO("Overlay invalidations={} flushes={}", invalidations_, flushes_);
+  for (auto &it : stats_) {
+    auto &s = it.second;
+    SZ_LOG_INFO("Overlay paint {}: count={} avg={}us max={}us total={}ms",
+                it.first, s.count, s.count > 0 ? s.total_us / s.count : 0,
+                s.max_us, s.total_us / 1000);
+  }
+
+  invalidations_ = 0;
+  flushes_ = 0;
+  stats_.clear();
+}
@@ -0,0 +1,89 @@
+#ifndef OVERLAY_COMPOSITOR_H
+#define OVERLAY_COMPOSITOR_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QObject>
+#include <QPointer>
+#include <QRegion>
+#include <QTimer>
+#include <QWidget>
+
+namespace suanzi {
+
+// Batches the repaints of the overlay widgets drawn over the video. Widgets
+// invalidate only the rectangles which changed, and the collected regions are
+// handed to Qt at most once per display refresh, however often detections
+// arrive. The time spent painting is measured per frame and per widget, and
+// logged periodically.
+class OverlayCompositor : public QObject {
+  Q_OBJECT
+
+ public:
+  // Can only be used from the GUI thread
+  static OverlayCompositor *get_instance();
+
+  // Measure the paint time of the window, which includes all its children
+  void attach(QWidget *window);
+
+  // Repaint rect of widget at the next refresh
+  void invalidate(QWidget *widget, const QRect &rect);
+
+  void add_paint_time(const std::string &name, int64_t us);
+
+  // Adds the time of its scope to the paint time of name
+  class PaintTimer {
+   public:
+    PaintTimer(const char *name)
+        : name_(name), start_(std::chrono::steady_clock::now()) {}
+    ~PaintTimer() {
+      OverlayCompositor::get_instance()->add_paint_time(
+          name_, std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start_)
+                     .count());
+    }
+
+   private:
+    const char *name_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  struct PaintStats {
+    int64_t count;
+    int64_t total_us;
+    int64_t max_us;
+  };
+
+  // Paint times since the last report, "frame" is the whole window
+  std::map<std::string, PaintStats> stats() const { return stats_; }
+
+ protected:
+  bool eventFilter(QObject *object, QEvent *event) override;
+
+ private slots:
+  void rx_flush();
+  void rx_report();
+
+ private:
+  static constexpr int DEFAULT_REFRESH_RATE = 60;
+  static constexpr int REPORT_INTERVAL_MS = 60000;
+
+  OverlayCompositor(QObject *parent = nullptr);
+
+  std::vector<std::pair<QPointer<QWidget>, QRegion>> dirty_;
+  QTimer flush_timer_;
+  QTimer report_timer_;
+
+  bool in_frame_;
+  int64_t invalidations_;
+  int64_t flushes_;
+  std::map<std::string, PaintStats> stats_;
+};
+
+}  // namespace suanzi
+
+#endif
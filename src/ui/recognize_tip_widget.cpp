@@ -14,10 +14,9 @@
 #include <QTimer>
 #include <QVBoxLayout>
 
-#include <opencv2/opencv.hpp>
-
+#include "avatar_cache.hpp"
 #include "config.hpp"
-#include "system.hpp"
+#include "system_info_task.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -43,7 +42,7 @@ RecognizeTipWidget::RecognizeTipWidget(int screen_width, int screen_height,
                       QFontDatabase::addApplicationFont(":asserts/clock.ttf"))
                       .at(0));
 
-  auto cfg = Config::get_user();
+  auto &cfg = Config::get_user();
   // draw time
   font_.setPointSize(0.0625 * w);
   pl_hh_mm_ = new QLabel(this);
@@ -113,10 +112,19 @@ RecognizeTipWidget::RecognizeTipWidget(int screen_width, int screen_height,
   connect((const QObject *)&reset_timer_, SIGNAL(timeout()),
           (const QObject *)this, SLOT(rx_reset()));
 
-  rx_update();
-  connect((const QObject *)&ip_timer_, SIGNAL(timeout()), (const QObject *)this,
-          SLOT(rx_update()));
-  ip_timer_.start(1000);
+  connect((const QObject *)AvatarCache::get_instance(),
+          SIGNAL(tx_loaded(QString)), (const QObject *)this,
+          SLOT(rx_avatar_loaded(QString)));
+
+  auto system_info = SystemInfoTask::get_instance();
+  rx_system_info(system_info->get());
+  connect((const QObject *)system_info, SIGNAL(tx_changed(SystemInfo)),
+          (const QObject *)this, SLOT(rx_system_info(SystemInfo)));
+
+  rx_timeout();
+  connect((const QObject *)&clock_timer_, SIGNAL(timeout()),
+          (const QObject *)this, SLOT(rx_timeout()));
+  clock_timer_.start(1000);
 }
 
 RecognizeTipWidget::~RecognizeTipWidget() {}
@@ -125,18 +133,13 @@ void RecognizeTipWidget::rx_display(PersonData person, bool audio_duplicated,
                                     bool record_duplicated) {
   person_ = person;
 
-  // avatar_.load(person_.face_path.c_str());
-  cv::Mat avatar = cv::imread(person_.face_path.c_str());
-  if (!avatar.empty()) {
-    cv::cvtColor(avatar, avatar, CV_BGR2RGB);
-    avatar_ = QPixmap::fromImage(QImage((unsigned char *)avatar.data,
-                                        avatar.cols, avatar.rows, avatar.step,
-                                        QImage::Format_RGB888));
-    avatar.release();
-  }
+  // A missed avatar is decoded in background and shown by rx_avatar_loaded
+  QImage avatar =
+      AvatarCache::get_instance()->get(person_.face_path, pl_avatar_->size());
+  avatar_ = avatar.isNull() ? QPixmap() : QPixmap::fromImage(avatar);
 
+  // The snapshot is converted to RGB by RecordTask
   if (!record_duplicated && !person.face_snapshot.empty()) {
-    cv::cvtColor(person.face_snapshot, person.face_snapshot, CV_BGR2RGB);
     snapshot_ = QPixmap::fromImage(
         QImage((unsigned char *)person.face_snapshot.data,
                person.face_snapshot.cols, person.face_snapshot.rows,
@@ -156,9 +159,11 @@ void RecognizeTipWidget::rx_display(PersonData person, bool audio_duplicated,
   reset_timer_.stop();
   reset_timer_.start();
 
-  if (person_.is_status_normal()) {
+  if (person_.is_status_normal() && !avatar_.isNull()) {
     pl_avatar_->setPixmap(avatar_);
     pl_avatar_->show();
+  } else {
+    pl_avatar_->hide();
   }
   if (!person.face_snapshot.empty()) {
     pl_snapshot_->setPixmap(snapshot_);
@@ -166,10 +171,27 @@ void RecognizeTipWidget::rx_display(PersonData person, bool audio_duplicated,
   }
 }
 
-void RecognizeTipWidget::rx_update() {
-  System::get_current_network(name_, ip_, mac_);
-  System::get_hostname(hostname_);
-  System::get_serial_number(serial_number_);
+void RecognizeTipWidget::rx_avatar_loaded(QString path) {
+  // Only if the tip is still showing this person
+  if (!reset_timer_.isActive() || path.toStdString() != person_.face_path ||
+      !person_.is_status_normal())
+    return;
+
+  QImage avatar =
+      AvatarCache::get_instance()->get(person_.face_path, pl_avatar_->size());
+  if (avatar.isNull()) return;
+
+  avatar_ = QPixmap::fromImage(avatar);
+  pl_avatar_->setPixmap(avatar_);
+  pl_avatar_->show();
+}
+
+void RecognizeTipWidget::rx_system_info(SystemInfo info) {
+  name_ = info.network;
+  ip_ = info.ip;
+  mac_ = info.mac;
+  hostname_ = info.hostname;
+  serial_number_ = info.serial_number;
 
   if (name_ == "eth0" || name_ == "wlan0") {
     std::istringstream sin(ip_);
@@ -194,7 +216,6 @@ void RecognizeTipWidget::rx_update() {
   sn_str = sn_str.replace(QRegExp("\\\n"), "");
   pl_sn_->setText(sn_str);
   pl_sn_->adjustSize();
-  rx_timeout();
 }
 
 void RecognizeTipWidget::rx_reset() {
@@ -217,7 +238,7 @@ void RecognizeTipWidget::check_temperature(bool &btemperature,
 
 void RecognizeTipWidget::rx_timeout() {
   auto lang = Config::get_user_lang();
-  auto cfg = Config::get_user();
+  auto &cfg = Config::get_user();
 
   // draw datetime
   QLocale locale;
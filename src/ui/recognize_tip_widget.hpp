@@ -9,6 +9,7 @@
 #include <QWidget>
 
 #include "person_service.hpp"
+#include "system_info_task.hpp"
 
 namespace suanzi {
 
@@ -29,7 +30,8 @@ class RecognizeTipWidget : public QWidget {
  private slots:
   void rx_display(PersonData person, bool audio_duplicated,
                   bool record_duplicated);
-  void rx_update();
+  void rx_avatar_loaded(QString path);
+  void rx_system_info(SystemInfo info);
   void rx_reset();
   void rx_timeout();
 
@@ -41,7 +43,7 @@ class RecognizeTipWidget : public QWidget {
   QFont font_;
   QPainterPath temperature_rect_;
   QTimer reset_timer_;
-  QTimer ip_timer_;
+  QTimer clock_timer_;
 
   bool has_info_;
 
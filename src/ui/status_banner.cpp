@@ -9,17 +9,17 @@
 #include <QHBoxLayout>
 #include <QPushButton>
 #include "config.hpp"
-#include "system.hpp"
+#include "face_journal.hpp"
+#include "system_info_task.hpp"
 
 using namespace suanzi;
 
 StatusBanner::StatusBanner(int screen_width, int screen_height, QWidget *parent)
-    : QWidget(parent), name_(""), last_name_("") {
+    : QWidget(parent), last_name_("") {
   setAttribute(Qt::WA_StyledBackground, true);
 
   person_service_ = PersonService::get_instance();
-  db_ = std::make_shared<FaceDatabase>(Config::get_quface().db_name);
-  db_->size(db_size_);
+  FaceJournal::get_instance()->size(db_size_);
 
   style_ =
       "QWidget { background-color:%1; margin:0px; } "
@@ -77,6 +77,11 @@ StatusBanner::StatusBanner(int screen_width, int screen_height, QWidget *parent)
 
   setLayout(ph_layout);
 
+  auto system_info = SystemInfoTask::get_instance();
+  rx_system_info(system_info->get());
+  connect((const QObject *)system_info, SIGNAL(tx_changed(SystemInfo)),
+          (const QObject *)this, SLOT(rx_system_info(SystemInfo)));
+
   rx_update();
   timer_ = new QTimer(this);
   connect(timer_, SIGNAL(timeout()), this, SLOT(rx_update()));
@@ -86,19 +91,21 @@ StatusBanner::StatusBanner(int screen_width, int screen_height, QWidget *parent)
 StatusBanner::~StatusBanner() { timer_->stop(); }
 
 void StatusBanner::rx_update() {
-  if (SZ_RETCODE_OK != db_->size(db_size_)) db_size_ = 0;
+  if (SZ_RETCODE_OK != FaceJournal::get_instance()->size(db_size_))
+    db_size_ = 0;
   pl_person_num_->setNum((int)db_size_);
 
-  auto cfg = Config::get_user();
+  auto &cfg = Config::get_user();
   if (cfg.enable_temperature) {
     pl_temperature_->show();
   } else {
     pl_temperature_->hide();
   }
+}
 
-  System::get_current_network(name_, ip_, mac_);
-  if (last_name_ != name_) {
-    last_name_ = name_;
+void StatusBanner::rx_system_info(SystemInfo info) {
+  if (last_name_ != info.network) {
+    last_name_ = info.network;
     QString style_str = "QLabel {border-image: url(:asserts/no_network.png);}";
     if (last_name_ == "eth0") {
       style_str = "QLabel {border-image: url(:asserts/wired_network.png);}";
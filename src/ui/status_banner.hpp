@@ -9,6 +9,7 @@
 
 #include "person_service.hpp"
 #include "quface_common.hpp"
+#include "system_info_task.hpp"
 
 namespace suanzi {
 
@@ -21,6 +22,7 @@ class StatusBanner : public QWidget {
 
  private slots:
   void rx_update();
+  void rx_system_info(SystemInfo info);
   void rx_display(bool invisible);
 
   void rx_temperature(bool bvisible, bool bnormal_temperature,
@@ -30,14 +32,13 @@ class StatusBanner : public QWidget {
   SZ_UINT32 db_size_;
 
   PersonService::ptr person_service_;
-  FaceDatabasePtr db_;
 
   QTimer *timer_;
   QLabel *pl_person_num_;
   QLabel *pl_temperature_;
   QLabel *pl_net_;
 
-  std::string name_, ip_, mac_, last_name_;
+  std::string last_name_;
 
   QString style_;
 };
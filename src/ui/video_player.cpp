@@ -7,6 +7,7 @@
 #include <QTimer>
 
 #include "config.hpp"
+#include "overlay_compositor.hpp"
 
 using namespace suanzi;
 using namespace suanzi::io;
@@ -103,9 +104,9 @@ void VideoPlayer::init_workflow() {
   if (Config::has_temperature_device()) {
     temperature_task_ = TemperatureTask::get_instance();
     connect((const QObject *)detect_task_,
-            SIGNAL(tx_temperature_target(DetectionRatio, bool)),
+            SIGNAL(tx_temperature_target(DetectionRatio, bool, qint64)),
             (const QObject *)temperature_task_,
-            SLOT(rx_update(DetectionRatio, bool)));
+            SLOT(rx_update(DetectionRatio, bool, qint64)));
     connect((const QObject *)temperature_task_, SIGNAL(tx_temperature(float)),
             (const QObject *)record_task_, SLOT(rx_temperature(float)));
   }
@@ -124,7 +125,10 @@ void VideoPlayer::init_widgets() {
 
   qRegisterMetaType<DetectionRatio>("DetectionRatio");
   qRegisterMetaType<PersonData>("PersonData");
-  qRegisterMetaType<TemperatureMatrix>("TemperatureMatrix");
+  qRegisterMetaType<ThermalFrame>("ThermalFrame");
+
+  // 统一调度叠加控件的重绘，并统计绘制耗时
+  OverlayCompositor::get_instance()->attach(this);
 
   // 初始化QT
   QPalette pal = palette();
@@ -208,9 +212,9 @@ void VideoPlayer::init_widgets() {
     connect((const QObject *)temperature_task_, SIGNAL(tx_heatmap_init(int)),
             (const QObject *)heatmap_widget_, SLOT(rx_init(int)));
     connect((const QObject *)temperature_task_,
-            SIGNAL(tx_heatmap(TemperatureMatrix, DetectionRatio, float, float)),
+            SIGNAL(tx_heatmap(ThermalFrame, DetectionRatio, float, float)),
             (const QObject *)heatmap_widget_,
-            SLOT(rx_update(TemperatureMatrix, DetectionRatio, float, float)));
+            SLOT(rx_update(ThermalFrame, DetectionRatio, float, float)));
   }
 
   isp_hist_widget_ = new ISPHistWidget(400, 300, this);
@@ -0,0 +1,29 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// CHECK for the standalone test executables: a failed check is printed and
+// counted, and the test goes on with the next one
+
+#include <cstdio>
+
+static int failures = 0;
+
+#define CHECK(cond)                                               \
+  do {                                                            \
+    if (!(cond)) {                                                \
+      printf("FAILED: %s:%d: %s\n", __FILE__, __LINE__, #cond);   \
+      failures++;                                                 \
+    }                                                             \
+  } while (0)
+
+// Prints the outcome of the checks, returns the exit code of the test
+static inline int check_result() {
+  if (failures > 0) {
+    printf("FAILED: %d checks\n", failures);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
+
+#endif
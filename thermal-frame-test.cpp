@@ -0,0 +1,195 @@
+// Checks ThermalFrame against the 16x16 code it replaced in TemperatureTask:
+// the in-place rotations of try_reading and the face statistics of
+// rx_update, on random frames and face boxes. Rotations of non-square frames
+// are checked for consistency. Exits with 1 if a check fails:
+//
+//   ./thermal-frame-test --rounds 10000
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "thermal_frame.hpp"
+#include "test_check.hpp"
+
+using namespace suanzi;
+
+static const int SIZE = 16;
+
+static float &value_at(std::vector<float> &mat, int x, int y) {
+  return mat[y * SIZE + x];
+}
+
+// The in-place rotations of TemperatureTask::try_reading
+static void legacy_rotate(std::vector<float> &mat, int degrees) {
+  switch (degrees) {
+    case 90:
+      for (int y = 0; y < SIZE / 2; y++) {
+        for (int x = y; x < SIZE - y - 1; x++) {
+          float t = value_at(mat, x, y);
+          value_at(mat, x, y) = value_at(mat, y, SIZE - x - 1);
+          value_at(mat, y, SIZE - x - 1) =
+              value_at(mat, SIZE - x - 1, SIZE - y - 1);
+          value_at(mat, SIZE - x - 1, SIZE - y - 1) =
+              value_at(mat, SIZE - y - 1, x);
+          value_at(mat, SIZE - y - 1, x) = t;
+        }
+      }
+      break;
+    case 180:
+      for (int y = 0; y < SIZE / 2; y++) {
+        for (int x = 0; x < SIZE; x++) {
+          float t = value_at(mat, x, y);
+          value_at(mat, x, y) = value_at(mat, SIZE - x - 1, SIZE - y - 1);
+          value_at(mat, SIZE - x - 1, SIZE - y - 1) = t;
+        }
+      }
+      break;
+    case 270:
+      for (int y = 0; y < SIZE / 2; y++) {
+        for (int x = y; x < SIZE - y - 1; x++) {
+          float t = value_at(mat, x, y);
+          value_at(mat, x, y) = value_at(mat, SIZE - y - 1, x);
+          value_at(mat, SIZE - y - 1, x) =
+              value_at(mat, SIZE - x - 1, SIZE - y - 1);
+          value_at(mat, SIZE - x - 1, SIZE - y - 1) =
+              value_at(mat, y, SIZE - x - 1);
+          value_at(mat, y, SIZE - x - 1) = t;
+        }
+      }
+      break;
+  }
+}
+
+// The statistics loop of TemperatureTask::rx_update
+static bool legacy_measure(const std::vector<float> &mat, float bx, float by,
+                           float bw, float bh, float &max_temperature,
+                           float &max_x, float &max_y, float &var) {
+  max_temperature = 0;
+  std::vector<float> statistics;
+  for (size_t i = 0; i < SIZE * SIZE; i++) {
+    float x = (i % SIZE) / (float)SIZE, y = (i / SIZE) / (float)SIZE;
+    if (pow(x - 0.5f, 2) + pow(y - 0.5f, 2) <= pow(6.f / 16.f, 2) &&
+        bx <= x && x <= bx + bw && by <= y && y <= by + bh) {
+      statistics.push_back(mat[i]);
+      if (mat[i] > max_temperature) {
+        max_temperature = mat[i];
+        max_x = x;
+        max_y = y;
+      }
+    }
+  }
+
+  float avg = 0;
+  var = 0;
+  for (float v : statistics) avg += v / statistics.size();
+  for (float v : statistics) var += (v - avg) * (v - avg);
+  return !statistics.empty();
+}
+
+// The measuring circle of TemperatureTask::update_mask
+static std::vector<uint8_t> circle_mask(int width, int height) {
+  const float RADIUS = 6.f / 16.f;
+  std::vector<uint8_t> mask(width * height);
+  for (int y = 0; y < height; y++) {
+    float dy = (float)y / height - 0.5f;
+    for (int x = 0; x < width; x++) {
+      float dx = (float)x / width - 0.5f;
+      mask[y * width + x] = dx * dx + dy * dy <= RADIUS * RADIUS;
+    }
+  }
+  return mask;
+}
+
+static std::vector<float> random_values(std::mt19937 &rng, int size) {
+  std::uniform_real_distribution<float> temperature(20, 40);
+  std::vector<float> values(size);
+  for (auto &v : values) v = temperature(rng);
+  return values;
+}
+
+static void test_rotation(std::mt19937 &rng) {
+  const int rotations[] = {0, 90, 180, 270};
+  auto src = random_values(rng, SIZE * SIZE);
+  for (int degrees : rotations) {
+    auto legacy = src;
+    legacy_rotate(legacy, degrees);
+
+    ThermalFrame frame;
+    frame.assign_rotated(src.data(), SIZE, SIZE, degrees);
+    CHECK(frame.width == SIZE && frame.height == SIZE);
+    CHECK(frame.values == legacy);
+  }
+
+  // Non-square frames, of sizes which are not multiples of the tile
+  const int sizes[][2] = {{32, 24}, {24, 32}, {13, 7}, {1, 5}};
+  for (auto &size : sizes) {
+    int width = size[0], height = size[1];
+    auto values = random_values(rng, width * height);
+
+    ThermalFrame r90, r180, r270, back;
+    r90.assign_rotated(values.data(), width, height, 90);
+    r180.assign_rotated(values.data(), width, height, 180);
+    r270.assign_rotated(values.data(), width, height, 270);
+    CHECK(r90.width == height && r90.height == width);
+    CHECK(r270.width == height && r270.height == width);
+    CHECK(r180.width == width && r180.height == height);
+
+    // The top left corner goes to the top right by 90 degrees clockwise
+    CHECK(r90.at(height - 1, 0) == values[0]);
+    CHECK(r270.at(0, width - 1) == values[0]);
+    CHECK(r180.at(width - 1, height - 1) == values[0]);
+
+    back.assign_rotated(r90.values.data(), r90.width, r90.height, 270);
+    CHECK(back.width == width && back.values == values);
+    back.assign_rotated(r180.values.data(), width, height, 180);
+    CHECK(back.values == values);
+  }
+}
+
+static void test_measure(std::mt19937 &rng, int rounds) {
+  auto mask = circle_mask(SIZE, SIZE);
+  std::uniform_int_distribution<int> cell(0, SIZE - 1);
+  std::uniform_real_distribution<float> extent(0.02, 0.8);
+
+  for (int i = 0; i < rounds; i++) {
+    ThermalFrame frame(SIZE, SIZE);
+    frame.values = random_values(rng, SIZE * SIZE);
+
+    // Boxes as rx_update makes them: the corner on a cell, any size
+    float x = cell(rng) / (float)SIZE, y = cell(rng) / (float)SIZE;
+    float w = extent(rng), h = extent(rng);
+    if (i % 2 == 0) w = (cell(rng) + 1) / (float)SIZE;
+
+    float max_temperature, max_x = 0.5, max_y = 0.5, var;
+    bool found = legacy_measure(frame.values, x, y, w, h, max_temperature,
+                                max_x, max_y, var);
+    auto stats = frame.measure(mask, x, y, w, h);
+    CHECK(found == (stats.count > 0));
+    if (!found) continue;
+
+    CHECK(stats.max_temperature == max_temperature);
+    CHECK(stats.max_x == max_x && stats.max_y == max_y);
+    double new_var =
+        stats.sum_squares - stats.sum * stats.sum / stats.count;
+    CHECK(std::fabs(new_var - var) <= 1e-3 * std::max(1.f, var));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = 10000;
+
+  for (int i = 1; i < argc - 1; i++) {
+    auto arg = std::string(argv[i]);
+    if (arg == "--rounds") rounds = atoi(argv[++i]);
+  }
+
+  std::mt19937 rng(42);
+  test_rotation(rng);
+  test_measure(rng, rounds);
+
+  return check_result();
+}
@@ -0,0 +1,234 @@
+// Checks the scheduling of ThreadPool: futures, the overflow policies of a
+// bounded queue, priorities and shutdown with and without draining. Exits
+// with 1 if a check fails:
+//
+//   ./thread-pool-test
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "test_check.hpp"
+#include "thread_pool.hpp"
+
+using namespace suanzi;
+
+// Keeps the single worker of a pool busy until open() is called, so the
+// tasks enqueued meanwhile stay in the queue
+class Gate {
+ public:
+  Gate() : opened_(opened_promise_.get_future().share()) {}
+
+  void block(ThreadPool &pool) {
+    auto started = std::make_shared<std::promise<void>>();
+    auto wait_started = started->get_future();
+    auto opened = opened_;
+    pool.enqueue([started, opened]() {
+      started->set_value();
+      opened.wait();
+    });
+    wait_started.wait();
+  }
+
+  void open() { opened_promise_.set_value(); }
+
+ private:
+  std::promise<void> opened_promise_;
+  std::shared_future<void> opened_;
+};
+
+template <class T>
+static bool is_broken(std::future<T> &f) {
+  try {
+    f.get();
+  } catch (const std::future_error &e) {
+    return e.code() == std::future_errc::broken_promise;
+  }
+  return false;
+}
+
+static void test_futures() {
+  ThreadPool pool(2);
+  auto sum = pool.enqueue([](int a, int b) { return a + b; }, 2, 3);
+  auto error =
+      pool.enqueue([]() -> int { throw std::runtime_error("request failed"); });
+  CHECK(sum.get() == 5);
+
+  bool thrown = false;
+  try {
+    error.get();
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+
+  pool.shutdown();
+  auto stats = pool.stats();
+  CHECK(stats.submitted == 2);
+  CHECK(stats.completed == 2);
+}
+
+static void test_reject() {
+  ThreadPool pool(1, 2, ThreadPool::REJECT);
+  Gate gate;
+  gate.block(pool);
+
+  auto a = pool.enqueue([]() { return 1; });
+  auto b = pool.enqueue([]() { return 2; });
+  CHECK(pool.queue_size() == 2);
+
+  bool rejected = false;
+  try {
+    pool.enqueue([]() { return 3; });
+  } catch (const ThreadPoolFullError &) {
+    rejected = true;
+  }
+  CHECK(rejected);
+  CHECK(pool.stats().rejected == 1);
+
+  gate.open();
+  CHECK(a.get() == 1);
+  CHECK(b.get() == 2);
+}
+
+static void test_drop_oldest() {
+  ThreadPool pool(1, 2, ThreadPool::DROP_OLDEST);
+  Gate gate;
+  gate.block(pool);
+
+  // The oldest task of the lowest priority is dropped, not the oldest one
+  auto normal = pool.enqueue_with_priority(ThreadPool::PRIORITY_NORMAL,
+                                           []() { return 1; });
+  auto low =
+      pool.enqueue_with_priority(ThreadPool::PRIORITY_LOW, []() { return 2; });
+  auto high =
+      pool.enqueue_with_priority(ThreadPool::PRIORITY_HIGH, []() { return 3; });
+  CHECK(pool.queue_size() == 2);
+  CHECK(pool.stats().dropped == 1);
+
+  gate.open();
+  CHECK(is_broken(low));
+  CHECK(normal.get() == 1);
+  CHECK(high.get() == 3);
+}
+
+static void test_drop_newest() {
+  ThreadPool pool(1, 2, ThreadPool::DROP_OLDEST);
+  Gate gate;
+  gate.block(pool);
+
+  // Nothing queued has a lower priority, so the new task is dropped
+  auto a =
+      pool.enqueue_with_priority(ThreadPool::PRIORITY_HIGH, []() { return 1; });
+  auto b = pool.enqueue_with_priority(ThreadPool::PRIORITY_NORMAL,
+                                      []() { return 2; });
+  auto low =
+      pool.enqueue_with_priority(ThreadPool::PRIORITY_LOW, []() { return 3; });
+  auto normal = pool.enqueue_with_priority(ThreadPool::PRIORITY_NORMAL,
+                                           []() { return 4; });
+  CHECK(pool.queue_size() == 2);
+  CHECK(pool.stats().dropped == 2);
+  CHECK(pool.stats().submitted == 3);
+
+  gate.open();
+  CHECK(is_broken(low));
+  CHECK(is_broken(normal));
+  CHECK(a.get() == 1);
+  CHECK(b.get() == 2);
+}
+
+static void test_block() {
+  ThreadPool pool(1, 1, ThreadPool::BLOCK);
+  Gate gate;
+  gate.block(pool);
+
+  pool.enqueue([]() {});
+  std::atomic<bool> enqueued(false);
+  std::thread producer([&]() {
+    pool.enqueue([]() {});
+    enqueued = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(!enqueued);
+
+  gate.open();
+  producer.join();
+  CHECK(enqueued);
+}
+
+static void test_priority() {
+  ThreadPool pool(1);
+  Gate gate;
+  gate.block(pool);
+
+  std::mutex mutex;
+  std::vector<int> order;
+  auto record = [&](int v) {
+    std::unique_lock<std::mutex> lock(mutex);
+    order.push_back(v);
+  };
+  pool.enqueue_with_priority(ThreadPool::PRIORITY_LOW, record, 0);
+  pool.enqueue_with_priority(ThreadPool::PRIORITY_NORMAL, record, 1);
+  pool.enqueue_with_priority(ThreadPool::PRIORITY_HIGH, record, 2);
+  pool.enqueue_with_priority(ThreadPool::PRIORITY_HIGH, record, 3);
+
+  gate.open();
+  pool.shutdown();
+  CHECK((order == std::vector<int>{2, 3, 1, 0}));
+}
+
+static void test_shutdown() {
+  {
+    ThreadPool pool(1);
+    Gate gate;
+    gate.block(pool);
+    auto queued = pool.enqueue([]() { return 1; });
+
+    std::thread closer([&]() { pool.shutdown(true); });
+    gate.open();
+    closer.join();
+    CHECK(queued.get() == 1);
+
+    bool thrown = false;
+    try {
+      pool.enqueue([]() {});
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+
+  {
+    ThreadPool pool(1);
+    Gate gate;
+    gate.block(pool);
+    auto queued = pool.enqueue([]() { return 1; });
+
+    std::thread closer([&]() { pool.shutdown(false); });
+    // Dropped once shutdown has taken the queue
+    while (pool.queue_size() > 0) std::this_thread::yield();
+    gate.open();
+    closer.join();
+    CHECK(is_broken(queued));
+    CHECK(pool.stats().dropped == 1);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  test_futures();
+  test_reject();
+  test_drop_oldest();
+  test_drop_newest();
+  test_block();
+  test_priority();
+  test_shutdown();
+
+  return check_result();
+}
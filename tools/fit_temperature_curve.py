@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Fit a temperature calibration curve from reference measurements.
+
+The CSV has one measurement per row, the value to calibrate and the value of
+the reference thermometer, e.g. the sensor reading and a surface thermometer
+for measure_to_surface, or the surface and a body thermometer for
+surface_to_inner:
+
+    measured,reference
+    30.12,35.40
+    ...
+
+The measurements are grouped into bins of equal count, each bin becomes a
+point at its median, and the points are made non-decreasing. The curve is
+printed as the calibrations entry of the temperature section of config.json:
+
+    ./fit_temperature_curve.py --curve measure_to_surface \
+        --manufacturer 2 measurements.csv
+"""
+
+import argparse
+import csv
+import json
+import re
+import statistics
+import sys
+
+
+def read_csv(filename, x_column, y_column):
+    points = []
+    with open(filename, newline='') as f:
+        for row in csv.DictReader(f):
+            try:
+                points.append((float(row[x_column]), float(row[y_column])))
+            except (KeyError, ValueError):
+                print('skip row: {}'.format(row), file=sys.stderr)
+    return sorted(points)
+
+
+def fit(points, num_points):
+    # Medians of bins with the same number of measurements, so the dense part
+    # of the range gets more points
+    num_points = max(1, min(num_points, len(points)))
+    curve = []
+    for i in range(num_points):
+        begin = i * len(points) // num_points
+        end = (i + 1) * len(points) // num_points
+        group = points[begin:end]
+        curve.append([
+            statistics.median(x for x, _ in group),
+            statistics.median(y for _, y in group),
+            len(group),
+        ])
+
+    # Pool adjacent violators, a higher reading never gives a lower result
+    pooled = []
+    for x, y, n in curve:
+        pooled.append([x, y, n])
+        while len(pooled) > 1 and pooled[-2][1] > pooled[-1][1]:
+            x1, y1, n1 = pooled.pop()
+            x0, y0, n0 = pooled.pop()
+            pooled.append([(x0 * n0 + x1 * n1) / (n0 + n1),
+                           (y0 * n0 + y1 * n1) / (n0 + n1), n0 + n1])
+
+    return [[round(x, 2), round(y, 2)] for x, y, _ in pooled]
+
+
+def interpolate(curve, x):
+    if x <= curve[0][0]:
+        return x + curve[0][1] - curve[0][0]
+    if x >= curve[-1][0]:
+        return x + curve[-1][1] - curve[-1][0]
+    for (x0, y0), (x1, y1) in zip(curve, curve[1:]):
+        if x0 <= x <= x1:
+            if x1 == x0:
+                return y1
+            return y0 + (x - x0) * (y1 - y0) / (x1 - x0)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Fit a temperature calibration curve')
+    parser.add_argument('csv', help='reference measurements')
+    parser.add_argument('--curve', default='measure_to_surface',
+                        choices=['measure_to_surface', 'surface_to_inner'])
+    parser.add_argument('--manufacturer', default='default',
+                        help='manufacturer id of the temperature module')
+    parser.add_argument('--points', type=int, default=12,
+                        help='maximum number of points of the curve')
+    parser.add_argument('--x-column', default='measured')
+    parser.add_argument('--y-column', default='reference')
+    args = parser.parse_args()
+
+    points = read_csv(args.csv, args.x_column, args.y_column)
+    if not points:
+        sys.exit('no measurements in {}'.format(args.csv))
+
+    curve = fit(points, args.points)
+
+    errors = [abs(interpolate(curve, x) - y) for x, y in points]
+    print('{} measurements, {} points, mean error {:.3f}, max error {:.3f}'.
+          format(len(points), len(curve), statistics.mean(errors),
+                 max(errors)),
+          file=sys.stderr)
+
+    # One point per line
+    entry = {'calibrations': {args.manufacturer: {args.curve: curve}}}
+    text = json.dumps(entry, indent=2)
+    print(re.sub(r'\[\s+([\d.-]+),\s+([\d.-]+)\s+\]', r'[\1, \2]', text))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,167 @@
+// Checks SequenceVoter against the vector based votes it replaced in
+// RecordTask::sequence_query, sequence_antispoof and sequence_mask, on random
+// histories and configurations. The old votes see the same window of the
+// newest SequenceVoter::CAPACITY frames. Exits with 1 if a vote differs:
+//
+//   ./voter-test --rounds 20000
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sequence_voter.hpp"
+#include "test_check.hpp"
+
+using namespace suanzi;
+
+// The counting of RecordTask::sequence_query, without the thresholds
+static bool legacy_query(const std::vector<QueryResult> &person_history,
+                         const std::vector<bool> &mask_history,
+                         bool has_mask, SZ_UINT32 &face_id, int &max_count,
+                         SZ_FLOAT &score, SZ_FLOAT &accumulate_score) {
+  std::map<SZ_UINT32, int> person_counts;
+  std::map<SZ_UINT32, float> person_accumulate_score;
+  std::map<SZ_UINT32, float> person_max_score;
+
+  max_count = 0;
+  auto pit = person_history.rbegin();
+  auto mit = mask_history.rbegin();
+  while (pit != person_history.rend() && mit != mask_history.rend()) {
+    if (*mit == has_mask) {
+      person_counts[pit->face_id] += 1;
+      person_accumulate_score[pit->face_id] += pit->score;
+      person_max_score[pit->face_id] =
+          std::max(pit->score, person_max_score[pit->face_id]);
+
+      if (person_counts[pit->face_id] > max_count) {
+        max_count = person_counts[pit->face_id];
+        face_id = pit->face_id;
+        score = person_max_score[face_id];
+        accumulate_score = person_accumulate_score[face_id];
+      }
+    }
+    pit++;
+    mit++;
+  }
+  return max_count > 0;
+}
+
+static bool legacy_antispoof(const std::vector<bool> &history, int min_count,
+                             int max_count, bool &is_live) {
+  if ((int)history.size() < min_count) return false;
+
+  int live_count = 0, count = 0;
+  for (auto it = history.rbegin(); it != history.rend(); it++) {
+    if (*it && ++live_count >= min_count) {
+      is_live = true;
+      return true;
+    }
+    if (++count >= max_count) {
+      is_live = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool legacy_mask(const std::vector<bool> &history, int max_person,
+                        bool &has_mask) {
+  if ((int)history.size() < max_person) return false;
+
+  int mask = 0, no_mask = 0;
+  for (auto it = history.rbegin(); it != history.rend(); it++) {
+    if (*it && ++mask >= max_person) {
+      has_mask = true;
+      return true;
+    }
+    if (!(*it) && ++no_mask >= max_person) {
+      has_mask = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+static void push_bounded(std::vector<T> &history, const T &value) {
+  history.push_back(value);
+  if (history.size() > SequenceVoter::CAPACITY)
+    history.erase(history.begin());
+}
+
+static void run_round(std::mt19937 &rng) {
+  const int capacity = SequenceVoter::CAPACITY;
+  auto uniform = [&](int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+  };
+
+  int ids = uniform(1, 4);
+  int history_size = uniform(1, capacity);
+  int min_alive_count = uniform(1, capacity);
+  int live_history_size = uniform(1, capacity);
+  int frames = uniform(0, capacity * 2);
+
+  SequenceVoter voter;
+  std::vector<QueryResult> person_history;
+  std::vector<bool> mask_history, live_history;
+
+  for (int i = 0; i < frames; i++) {
+    QueryResult person;
+    person.face_id = uniform(0, ids - 1);
+    person.score = uniform(0, 99) / 100.f;
+    bool has_mask = uniform(0, 2) == 0;
+    bool is_live = uniform(0, 1) == 1;
+
+    push_bounded(person_history, person);
+    push_bounded(mask_history, has_mask);
+    push_bounded(live_history, is_live);
+    voter.add_person(person, has_mask);
+    voter.add_live(is_live);
+
+    bool expected = false, actual = false;
+    bool decided = legacy_mask(mask_history, history_size, expected);
+    CHECK(voter.vote_mask(history_size, actual) == decided);
+    if (decided) CHECK(actual == expected);
+
+    decided = legacy_antispoof(live_history, min_alive_count,
+                               live_history_size, expected);
+    CHECK(voter.vote_live(min_alive_count, live_history_size, actual) ==
+          decided);
+    if (decided) CHECK(actual == expected);
+
+    for (int mask = 0; mask < 2; mask++) {
+      SZ_UINT32 legacy_id = 0, face_id = 0;
+      int legacy_count = 0, count = 0;
+      SZ_FLOAT legacy_max = 0, max_score = 0, legacy_sum = 0, sum_score = 0;
+      decided = legacy_query(person_history, mask_history, mask, legacy_id,
+                             legacy_count, legacy_max, legacy_sum);
+      CHECK(voter.vote_person(mask, face_id, count, max_score, sum_score) ==
+            decided);
+      if (!decided) continue;
+
+      // Both sum the scores newest first, so the sums match exactly
+      CHECK(face_id == legacy_id);
+      CHECK(count == legacy_count);
+      CHECK(max_score == legacy_max);
+      CHECK(sum_score == legacy_sum);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = 20000;
+
+  for (int i = 1; i < argc - 1; i++) {
+    auto arg = std::string(argv[i]);
+    if (arg == "--rounds") rounds = atoi(argv[++i]);
+  }
+
+  std::mt19937 rng(42);
+  for (int i = 0; i < rounds && failures == 0; i++) run_round(rng);
+
+  return check_result();
+}